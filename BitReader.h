@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+/// Read individual bits from a file written by BitWriter (most significant bit of each byte first)
+/**
+ * The next bits of the input are kept left-aligned in a 64-bit window that
+ * is refilled byte-wise, so up to maxPeekBits bits can be inspected with
+ * peekBits() and then skipped with consume(), e.g., for table-driven decoding.
+ */
+class BitReader {
+public:
+    /// The maximum number of bits that can be peeked at once
+    static const unsigned int maxPeekBits = 57;
+
+    /// Read the whole file into memory
+    BitReader(const std::string &fn) : data(), pos(0), bytePos(0), window(0), windowBits(0), ok(false) {
+        std::ifstream in(fn, std::ios::binary | std::ios::in);
+        if (!in.is_open()) {
+            return;
+        }
+        data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        ok = true;
+    }
+
+    /// Read from a copy of the bytes [begin, end), e.g., a part of another reader's input
+    BitReader(const unsigned char *begin, const unsigned char *end)
+        : data(begin, end), pos(0), bytePos(0), window(0), windowBits(0), ok(true) {}
+
+    /// An empty reader
+    BitReader() : data(), pos(0), bytePos(0), window(0), windowBits(0), ok(false) {}
+
+    /// Whether the input file could be read
+    bool good() const {
+        return ok;
+    }
+
+    /// Get the next `length` (at most maxPeekBits) bits without consuming them.
+    /// Reading beyond the end of the input yields zeroes.
+    uint64_t peekBits(const unsigned int length) {
+        assert(length <= maxPeekBits);
+        if (windowBits < length) {
+            refill();
+        }
+        return length == 0 ? 0 : window >> (64 - length);
+    }
+
+    /// Skip `length` bits that were peeked before
+    void consume(const unsigned int length) {
+        assert(length <= windowBits);
+        window = (length == 64) ? 0 : window << length;
+        windowBits -= length;
+        pos += length;
+    }
+
+    /// Read a bit. Reading beyond the end of the input yields zeroes.
+    bool readBit() {
+        const bool bit = peekBits(1);
+        consume(1);
+        return bit;
+    }
+
+    /// Read `length` (at most 64) bits, most significant one first
+    uint64_t readBits(const unsigned int length) {
+        if (length <= maxPeekBits) {
+            const uint64_t result = peekBits(length);
+            consume(length);
+            return result;
+        }
+        const unsigned int high = length - 32;
+        const uint64_t result = peekBits(high);
+        consume(high);
+        return (result << 32) | readBits(32);
+    }
+
+    /// Read a positive number in Elias gamma code, see BitWriter::writeGamma()
+    uint64_t readGamma() {
+        unsigned int zeroes(0);
+        while (!readBit()) {
+            if (++zeroes >= 64 || overrun()) return 0;
+        }
+        return zeroes == 0 ? 1 : ((1ull << zeroes) | readBits(zeroes));
+    }
+
+    /// Skip the padding bits up to the next byte boundary, see BitWriter::alignToByte()
+    void alignToByte() {
+        if (pos % 8 != 0) {
+            readBits(8 - pos % 8);
+        }
+    }
+
+    /// Direct access to the input at the current position, which must be at a byte boundary
+    const unsigned char *bytes() const {
+        assert(pos % 8 == 0);
+        return data.data() + std::min(pos / 8, data.size());
+    }
+
+    /// The number of bytes from the current position (at a byte boundary) to the end of the input
+    size_t bytesLeft() const {
+        assert(pos % 8 == 0);
+        return pos / 8 < data.size() ? data.size() - pos / 8 : 0;
+    }
+
+    /// Skip `count` bytes, e.g., after decoding them via bytes(). The position must be at a byte boundary.
+    void skipBytes(const size_t count) {
+        assert(pos % 8 == 0);
+        pos += count * 8;
+        bytePos = pos / 8;
+        window = 0;
+        windowBits = 0;
+    }
+
+    /// Whether there are any bits left (the last byte's padding counts as data)
+    bool hasMore() const {
+        return pos < data.size() * 8;
+    }
+
+    /// Whether more bits were read than the input contains, i.e., the input was truncated
+    bool overrun() const {
+        return pos > data.size() * 8;
+    }
+
+    /// Size of the input in bytes
+    size_t size() const {
+        return data.size();
+    }
+
+protected:
+    /// Fill the window with at least maxPeekBits bits (zeroes beyond the end of the input)
+    void refill() {
+        while (windowBits <= 56) {
+            const uint64_t byte = (bytePos < data.size()) ? data[bytePos] : 0;
+            window |= byte << (56 - windowBits);
+            windowBits += 8;
+            ++bytePos;
+        }
+    }
+
+    std::vector<unsigned char> data;
+    /// number of bits consumed
+    size_t pos;
+    /// next byte to load into the window
+    size_t bytePos;
+    uint64_t window;
+    unsigned int windowBits;
+    bool ok;
+};
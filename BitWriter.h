@@ -1,20 +1,119 @@
 #pragma once
 
 #include <bitset>
-#include <cstring>
+#include <cassert>
+#include <cstdint>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <vector>
 
-/// Unfinished, untested, unused bit writer
+/// Collect bits in memory, most significant bit first
+/**
+ * Bits are shifted into a 64-bit accumulator, which is appended to a vector
+ * of words whenever it is full, so writing a code of up to 64 bits costs a
+ * shift and an or instead of a loop over the bits.
+ */
+class BitBuffer {
+public:
+    BitBuffer() : words(), acc(0), accBits(0) {}
+
+    /// Append the lowest `length` (at most 64) bits of `data`, most significant one first
+    void writeBits(uint64_t data, const unsigned int length) {
+        assert(length <= 64);
+        if (length == 0) return;
+        if (length < 64) data &= (1ull << length) - 1;
+        const unsigned int free = 64 - accBits;
+        if (length < free) {
+            acc = (acc << length) | data;
+            accBits += length;
+        } else {
+            // fill up the accumulator, keep the remaining bits (the garbage above them is shifted out later)
+            const unsigned int rest = length - free;
+            words.push_back((free == 64 ? 0 : acc << free) | (data >> rest));
+            acc = data;
+            accBits = rest;
+        }
+    }
+
+    /// Append the codes of a sequence of symbols. Faster than writing them one by one, as the
+    /// accumulator stays in a register.
+    /// \param table maps a symbol to its code, which needs members `bits` and `length` (at most 64)
+    template <typename InputIterator, typename CodeTable>
+    void writeCodes(InputIterator begin, InputIterator end, const CodeTable &table) {
+        uint64_t a(acc);
+        unsigned int aBits(accBits);
+        for (auto it = begin; it != end; ++it) {
+            const auto &code = table[*it];
+            const unsigned int free = 64 - aBits;
+            if (code.length < free) {
+                a = (a << code.length) | code.bits;
+                aBits += code.length;
+            } else {
+                const unsigned int rest = code.length - free;
+                words.push_back((free == 64 ? 0 : a << free) | (code.bits >> rest));
+                a = code.bits;
+                aBits = rest;
+            }
+        }
+        acc = a;
+        accBits = aBits;
+    }
+
+    /// Append a sequence of bits
+    void writeBits(const std::vector<bool> &vec) {
+        for (const bool bit : vec) {
+            writeBits(bit, 1);
+        }
+    }
+
+    /// Append the contents of another buffer
+    void writeBits(const BitBuffer &other) {
+        for (const uint64_t word : other.words) {
+            writeBits(word, 64);
+        }
+        writeBits(other.acc, other.accBits);
+    }
+
+    /// The number of bits in the buffer
+    size_t size() const {
+        return words.size() * 64 + accBits;
+    }
+
+    /// Discard the buffer's contents
+    void clear() {
+        words.clear();
+        acc = 0;
+        accBits = 0;
+    }
+
+    /// Full 64-bit words, most significant bit first
+    std::vector<uint64_t> words;
+    /// The last accBits bits that don't make a full word yet, in the lowest bits of acc
+    uint64_t acc;
+    unsigned int accBits;
+};
+
+/// Write individual bits to a file or to memory, most significant bit of each byte first
+/**
+ * The bits are collected in a BitBuffer and written out in whole words
+ * once the buffer holds `buffersize` of them.
+ */
 class BitWriter {
 public:
+    /// buffer size in 64-bit words
     static const int buffersize = 1024;
 
-    BitWriter(const std::string &fn): fn(fn), bufitem(0), itempos(7), bytesWritten(0) {
+    BitWriter(const std::string &fn): fn(fn), toMemory(false), buffer(), bytes(), memory(), bytesWritten(0) {
         out.open(fn, std::ios::binary | std::ios::out);
-        memset(buffer, 0, buffersize);
+        buffer.words.reserve(buffersize);
+        bytes.reserve(buffersize * sizeof(uint64_t));
+    }
+
+    /// Write to memory instead of a file, see getData()
+    BitWriter(): fn(), toMemory(true), buffer(), bytes(), memory(), bytesWritten(0) {
+        buffer.words.reserve(buffersize);
+        bytes.reserve(buffersize * sizeof(uint64_t));
     }
 
     ~BitWriter() {
@@ -23,43 +122,72 @@ public:
         }
     }
 
-    void writeBits(int data, size_t length) {
-        for (unsigned int i = length; i--;) {
-            std::cout << "Processing bit " << i << " of " << length << ": ORing buffer[" << bufitem << "] with " << (((data >> i) & 0x1) << itempos) << " (itempos " << itempos << ")" << std::endl;
-            buffer[bufitem] |= ((data >> i) & 0x1) << itempos;
-            bufitem += (itempos == 0);
-            itempos = (itempos - 1) & 0x7;
+    /// Whether the output file could be opened
+    bool good() const {
+        return toMemory || out.good();
+    }
 
-            if (bufitem == buffersize) {
-                writeBuffer();
-            }
+    /// Write the lowest `length` (at most 64) bits of `data`, most significant one first
+    void writeBits(const uint64_t data, const unsigned int length) {
+        buffer.writeBits(data, length);
+        if (buffer.words.size() >= buffersize) {
+            writeWords();
         }
     }
 
     void writeBits(const std::vector<bool> &vec) {
-        for (bool bit : vec) {
-            buffer[bufitem] |= bit << itempos;
-            bufitem += (itempos == 0);
-            itempos = (itempos - 1) & 0x7;
+        for (const bool bit : vec) {
+            writeBits(bit, 1);
+        }
+    }
 
-            if (bufitem == buffersize) {
-                writeBuffer();
-            }
+    /// Write a positive number in Elias gamma code: the number's length in unary, then the number
+    void writeGamma(const uint64_t value) {
+        assert(value > 0);
+        const unsigned int length = 64 - __builtin_clzll(value);
+        writeBits(0, length - 1);
+        writeBits(value, length);
+    }
+
+    /// Pad the output with zeroes up to the next byte boundary
+    void alignToByte() {
+        // the words are full, so the position within a byte only depends on the accumulator
+        writeBits(0, (8 - buffer.accBits % 8) % 8);
+    }
+
+    /// Write whole bytes, e.g., the data of another BitWriter. Must be at a byte boundary.
+    void writeBytes(const std::vector<char> &data) {
+        assert(buffer.accBits % 8 == 0);
+        write();
+        bytes.insert(bytes.end(), data.cbegin(), data.cend());
+        writeBytes();
+    }
+
+    /// Write the contents of a BitBuffer
+    void writeBits(const BitBuffer &other) {
+        for (const uint64_t word : other.words) {
+            writeBits(word, 64);
         }
+        writeBits(other.acc, other.accBits);
     }
 
+    /// Write out the buffer, including a partially filled last byte (padded with zeroes)
     void write() {
-        bytesWritten += bufitem;
-        out.write((char*)&buffer, bufitem);
-        memset(buffer, 0, bufitem);
-        bufitem = 0;
-        itempos = 7;
+        writeWords();
+        if (buffer.accBits > 0) {
+            const uint64_t word = buffer.acc << (64 - buffer.accBits);
+            const unsigned int numBytes = (buffer.accBits + 7) / 8;
+            for (unsigned int i = 0; i < numBytes; ++i) {
+                bytes.push_back((char)(word >> (56 - 8 * i)));
+            }
+            writeBytes();
+        }
+        buffer.clear();
     }
 
+    /// Discard all bits that were not written out yet
     void clear() {
-        bufitem = 0;
-        itempos = 7;
-        memset(buffer, 0, bufitem);
+        buffer.clear();
     }
 
     void close() {
@@ -67,8 +195,11 @@ public:
     }
 
     void dump() {
-        for (unsigned int i = 0; i <= bufitem; i++) {
-            std::cout << std::bitset<8>(buffer[i]) << " ";
+        for (const uint64_t word : buffer.words) {
+            std::cout << std::bitset<64>(word) << " ";
+        }
+        for (unsigned int i = buffer.accBits; i--;) {
+            std::cout << ((buffer.acc >> i) & 0x1);
         }
         std::cout << std::endl;
     }
@@ -77,17 +208,43 @@ public:
         return bytesWritten;
     }
 
+    /// The bytes written out so far by a BitWriter that writes to memory
+    const std::vector<char> &getData() const {
+        assert(toMemory);
+        return memory;
+    }
+
 protected:
-    void writeBuffer() {
-        bytesWritten += buffersize;
-        out.write((char*)&buffer, buffersize);
-        bufitem = 0;
-        memset(buffer, 0, buffersize);
+    /// Write out the full words of the buffer
+    void writeWords() {
+        const size_t offset = bytes.size();
+        bytes.resize(offset + buffer.words.size() * sizeof(uint64_t));
+        char *dest = bytes.data() + offset;
+        for (const uint64_t word : buffer.words) {
+            for (int shift = 56; shift >= 0; shift -= 8) {
+                *dest++ = (char)(word >> shift);
+            }
+        }
+        buffer.words.clear();
+        writeBytes();
     }
-    const std::string &fn;
+
+    void writeBytes() {
+        bytesWritten += bytes.size();
+        if (toMemory) {
+            memory.insert(memory.end(), bytes.cbegin(), bytes.cend());
+        } else {
+            out.write(bytes.data(), bytes.size());
+        }
+        bytes.clear();
+    }
+
+    const std::string fn;
+    const bool toMemory;
     std::ofstream out;
-    unsigned char buffer[buffersize];
-    unsigned int bufitem;
-    unsigned int itempos;
+    BitBuffer buffer;
+    std::vector<char> bytes;
+    /// the output of a BitWriter that writes to memory
+    std::vector<char> memory;
     unsigned long long bytesWritten;
 };
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cassert>
+#include <vector>
+
+#include "Common.h"
+
+/// Where the nodes of each cluster of a Top DAG lie in the tree's preorder, independent of
+/// where in the tree the cluster occurs
+/**
+ * A cluster's nodes are contiguous in preorder, except for the subtree hanging below its
+ * bottom boundary node (if there is one). This splits them into the nodes before that
+ * subtree (preSizes, ending with the boundary node) and those after it (postSizes).
+ * boundaryDepths holds the depth of the bottom boundary node relative to the node the
+ * cluster hangs below (0 if there is none).
+ *
+ * This is computed bottom-up in one pass in O(|DAG|) for preorder queries, path queries
+ * and analytics. The DAG can be a TopDag, FrozenTopDag or MappedTopDag.
+ */
+struct ClusterSizes {
+    ClusterSizes() : preSizes(), postSizes(), boundaryDepths() {}
+
+    /// Annotate the clusters of a Top DAG (unless this was done already)
+    /// \param dag the Top DAG. Must be final (no more clusters added)
+    template <typename DAGType>
+    void compute(const DAGType &dag) {
+        if (!preSizes.empty()) return;
+        preSizes.assign(dag.nodes.size(), 0);
+        postSizes.assign(dag.nodes.size(), 0);
+        boundaryDepths.assign(dag.nodes.size(), 0);
+        // children always have smaller IDs than their parents
+        for (uint nodeId = 1; nodeId < dag.nodes.size(); ++nodeId) {
+            const auto &node = dag.nodes[nodeId];
+            if (node.left < 0) {
+                preSizes[nodeId] = 1;
+                boundaryDepths[nodeId] = 1;
+                continue;
+            }
+            const unsigned long long leftPre(preSizes[node.left]), leftPost(postSizes[node.left]);
+            const unsigned long long rightPre(preSizes[node.right]), rightPost(postSizes[node.right]);
+            switch (node.mergeType) {
+            case VERT_WITH_BBN:
+            case VERT_NO_BBN:
+                // the right cluster hangs below the left cluster's boundary node
+                preSizes[nodeId] = leftPre + rightPre;
+                postSizes[nodeId] = rightPost + leftPost;
+                boundaryDepths[nodeId] = (node.mergeType == VERT_WITH_BBN) ?
+                    boundaryDepths[node.left] + boundaryDepths[node.right] : 0;
+                break;
+            case HORZ_LEFT_BBN:
+                preSizes[nodeId] = leftPre;
+                postSizes[nodeId] = leftPost + rightPre + rightPost;
+                boundaryDepths[nodeId] = boundaryDepths[node.left];
+                break;
+            case HORZ_RIGHT_BBN:
+                preSizes[nodeId] = leftPre + leftPost + rightPre;
+                postSizes[nodeId] = rightPost;
+                boundaryDepths[nodeId] = boundaryDepths[node.right];
+                break;
+            case HORZ_NO_BBN:
+                preSizes[nodeId] = leftPre + leftPost + rightPre + rightPost;
+                break;
+            default:
+                assert(false);
+            }
+        }
+    }
+
+    /// The number of tree nodes in a cluster
+    unsigned long long size(const int nodeId) const {
+        return preSizes[nodeId] + postSizes[nodeId];
+    }
+
+    /// the number of the cluster's nodes before / after the subtree below its boundary node in preorder
+    std::vector<unsigned long long> preSizes, postSizes;
+    /// relative depth of each cluster's bottom boundary node (0 if there is none)
+    std::vector<uint> boundaryDepths;
+};
@@ -2,6 +2,7 @@
 
 #include <random>
 #include <stack>
+#include <sys/resource.h>
 #include <sys/stat.h>
 
 #ifdef NDEBUG
@@ -27,6 +28,15 @@ T log_2(T val) {
     return result;
 }
 
+/// The number of bits needed to represent the values 0, ..., n-1 (at least 1)
+inline int bitsFor(const unsigned long long n) {
+    int bits(1);
+    while (bits < 64 && (1ull << bits) < n) {
+        ++bits;
+    }
+    return bits;
+}
+
 /// Types of merges in the top tree (see top tree compression paper for details)
 enum MergeType { NO_MERGE = -1, VERT_WITH_BBN, VERT_NO_BBN, HORZ_LEFT_BBN, HORZ_RIGHT_BBN, HORZ_NO_BBN };
 
@@ -50,6 +60,24 @@ std::mt19937 &getRandomGenerator() {
 }
 
 
+/// Get the size of a file in bytes, or -1 if it can't be accessed
+long long getFileSize(const std::string &path) {
+    struct stat s;
+    if (stat(path.c_str(), &s) != 0) {
+        return -1;
+    }
+    return s.st_size;
+}
+
+/// Get the peak resident set size of this process so far in bytes, or -1 if it can't be determined
+long long getPeakMemoryUsage() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+    return usage.ru_maxrss * 1024LL; // in kilobytes on Linux
+}
+
 /// Recursively create a path (similar to "mkdir -p")
 /// see also http://stackoverflow.com/a/11366985 by StackOverflow user "Mark"
 bool makePathRecursive(std::string path, int permissions = 0755) {
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <functional>
 #include <ostream>
 #include <sstream>
 #include <unordered_map>
@@ -8,29 +11,24 @@
 #include "TopDag.h"
 #include "Labels.h"
 
+#include "FrontCoding.h"
+#include "Histogram.h"
 #include "Huffman.h"
+#include "Parallel.h"
+#include "Rans.h"
+#include "StreamVByte.h"
 
 /// Calculate entropy of a sequence of symbols
-template <typename T, typename CounterType = int>
+template <typename T, typename CounterType = uint64_t>
 class EntropyCalculator {
 public:
     /// Initialise entropy calculator
-    EntropyCalculator() : numItems(0), freq() {}
+    EntropyCalculator() : freq() {}
 
     /// add an occurence to the entropy calculation
-    /// \param item the item to add, by const reference
+    /// \param item the item to add
     void addItem(const T &item) {
-        CounterType &count = freq[item];
-        ++count;
-        ++numItems;
-    }
-
-    /// add an occurence to the entropy calculation
-    /// \param item the item to add, by rvalue reference
-    void addItem(T &&item) {
-        CounterType &count = freq[item];
-        ++count;
-        ++numItems;
+        freq.addItem(item);
     }
 
     /// Add a number of items [begin, end) to the entropy calculation
@@ -38,67 +36,56 @@ public:
     /// \param end the iterator to the item beyond the last one to add
     template <class InputIterator>
     void addSequence(InputIterator begin, InputIterator end) {
-        for (auto it = begin; it != end; ++it) {
-            addItem(*it);
-        }
+        freq.addItems(begin, end);
     }
 
     /// The number of distinct symbols encountered
     size_t numSymbols() const {
-        return freq.size();
+        return freq.getNumSymbols();
     }
 
     /// The number of occurences counted
     CounterType numOccurences() const {
-        return numItems;
+        return freq.getNumItems();
     }
 
     /// The entropy of a memoryless source using the symbol frequencies observed
     double getEntropy() const {
         double entropy(0.0);
-        for (auto it = freq.cbegin(); it != freq.cend(); ++it) {
-            if (it->second == 0) continue;
-            double relativeFrequency(((double)it->second) / numItems);
-            entropy -= relativeFrequency * log_2(relativeFrequency);
-        }
+        const double numItems = freq.getNumItems();
+        freq.forEach([&](const T &, const uint64_t count) {
+            const double relativeFrequency(count / numItems);
+            entropy -= relativeFrequency * std::log2(relativeFrequency);
+        });
         return entropy;
     }
 
     /// The optimal number of bits to code a symbol
-    /// \param symbol the symbol by const reference
+    /// \param symbol the symbol
     double optBitsForSymbol(const T &symbol) const {
-        CounterType occurrences(freq.at(symbol));
-        if (occurrences == 0) return 0;
-        return -1*log_2(((double)occurrences) / numItems);
-    }
-
-    /// The optimal number of bits to code a symbol
-    /// \param symbol the symbol by rvalue reference
-    double optBitsForSymbol(T &&symbol) const {
-        CounterType occurrences(freq.at(symbol));
+        const CounterType occurrences(freq.count(symbol));
         if (occurrences == 0) return 0;
-        return -1*log_2(((double)occurrences) / numItems);
+        return -1*std::log2(((double)occurrences) / freq.getNumItems());
     }
 
     /// A short string summary of the data collected
     std::string summary() const {
         std::stringstream s;
-        s << freq.size() << " symbols, " << numItems << " occurrences: "
-          << getEntropy()  << " b/symbol on avg; need at least" << (int)ceil(getEntropy() * numItems) << " bits" << std::endl;
+        s << numSymbols() << " symbols, " << numOccurences() << " occurrences: "
+          << getEntropy()  << " b/symbol on avg; need at least" << (uint64_t)ceil(getEntropy() * numOccurences()) << " bits" << std::endl;
         return s.str();
     }
 
     friend std::ostream &operator<<(std::ostream &os, const EntropyCalculator &entropy) {
         os << entropy.summary();
-        for (auto it = entropy.freq.cbegin(); it != entropy.freq.cend(); ++it) {
-            os << (int)it->first << ": " << entropy.optBitsForSymbol(it->first) << " bits, " << it->second << " occurrences" << std::endl;
-        }
+        entropy.freq.forEach([&](const T &symbol, const uint64_t count) {
+            os << (int)symbol << ": " << entropy.optBitsForSymbol(symbol) << " bits, " << count << " occurrences" << std::endl;
+        });
         return os;
     }
 
 private:
-    CounterType numItems;
-    std::unordered_map<T, CounterType> freq;
+    Histogram<T> freq;
 };
 
 
@@ -110,210 +97,249 @@ struct LabelDataEntropy;
 template <>
 struct LabelDataEntropy<std::string> {
     /// Create entropy calculator
-    /// \param labels the labels for which to calculate the entropy
-    LabelDataEntropy(const Labels<std::string> &labels) : labels(labels), huffman() {}
+    /// \param dag the DAG whose leaves' labels shall be coded (in the order of the leaves)
+    LabelDataEntropy(const TopDag<std::string> &dag) : dag(dag), huffman() {}
 
     /// Do entropy calculation
     void construct() {
-        for (const std::string* label : labels.valueIndex) {
-            if (label != NULL) {
-                huffman.addItems(label->cbegin(), label->cend());
-            }
-            huffman.addItem(0);
-        }
+        addTo(huffman);
         huffman.construct();
     }
 
-    /// Write the labels to a Huffman writer.
-    void addToWriter(HuffmanWriter<std::string::value_type> &writer) {
-        for (const std::string* label : labels.valueIndex) {
-            if (label != NULL) {
-                writer.addItems(label->cbegin(), label->cend());
-            }
-            writer.addItem(0);
+    /// Write the labels to a writer (HuffmanWriter or RansWriter).
+    template <typename Writer>
+    void addToWriter(Writer &writer) {
+        addTo(writer);
+    }
+
+    /// Get the leaves' node IDs, sorted by their labels except for the first leaf, which
+    /// holds the root's label and needs to stay first (see TopDagUnpacker)
+    vector<int> getSortedLeaves() const {
+        vector<int> leaves;
+        for (int nodeId = 1; nodeId < (int)dag.nodes.size() && dag.nodes[nodeId].left < 0; ++nodeId) {
+            leaves.push_back(nodeId);
+        }
+        std::sort(leaves.begin() + 1, leaves.end(), [this](const int a, const int b) {
+            return *dag.nodes[a].label < *dag.nodes[b].label;
+        });
+        return leaves;
+    }
+
+    /// Write the labels front-coded, in the order given by getSortedLeaves()
+    void addSortedToWriter(FrontCodingWriter &writer) const {
+        for (const int nodeId : getSortedLeaves()) {
+            writer.addItem(*dag.nodes[nodeId].label);
         }
     }
 
     /// Additional amount of information that needs to be stored, in bits
-    /// (e.g. for mapping code points to symbols)
-    int getExtraSize() const {
-        return huffman.getNumSymbols() * sizeof(std::string::value_type) * 8;
+    /// (the code points in the Huffman table)
+    long long getExtraSize() const {
+        return huffman.getBitsForTableLabels(sizeof(std::string::value_type) * 8);
     }
 
-    const Labels<std::string> &labels;
+    const TopDag<std::string> &dag;
     HuffmanBuilder<std::string::value_type> huffman;
+
+protected:
+    /// Add the leaves' labels as zero-terminated strings
+    template <typename Sink>
+    void addTo(Sink &sink) {
+        for (uint nodeId = 1; nodeId < dag.nodes.size() && dag.nodes[nodeId].left < 0; ++nodeId) {
+            const std::string *label = dag.nodes[nodeId].label;
+            sink.addItems(label->cbegin(), label->cend());
+            sink.addItem(0);
+        }
+    }
 };
 
 
 enum NodeEncoding { IMPLICIT, MISSING };
 
-/// Calculate the different entropies of a TopDag - its structure, its merge types, and its labels
-template <typename DataType>
-struct DagEntropy {
-    DagEntropy(const TopDag<DataType> &dag, const Labels<DataType> &labels, BitWriter &writer) :
-        dagStructureEntropy(),
-        dagPointerEntropy(),
-        mergeEntropy(),
-        labelDataEntropy(labels),
-        writer(writer),
-        dagStructureWriter(dagStructureEntropy.huffman, writer),
-        dagPointerWriter(dagPointerEntropy, writer),
-        mergeWriter(mergeEntropy.huffman, writer),
-        labelWriter(labelDataEntropy.huffman, writer),
-        dag(dag)
-    {}
-
-    /// Do the entropy calculations on the DAG's nodes
-    void calculate() {
-        vector<bool> alreadyVisited(dag.nodes.size(), false);
-
-        const auto isLeafOrPointer([&](const int nodeId) {
-            assert((dag.nodes[nodeId].left < 0) == (dag.nodes[nodeId].right < 0));
-            return (alreadyVisited[nodeId] || dag.nodes[nodeId].left < 0);
-        });
-
-        // Add structure and label information for a **child** of the current node
-        const auto codeStructure([&](const int nodeId) {
-            assert(nodeId >= 0);
-            if (isLeafOrPointer(nodeId)) {
-                dagStructureEntropy.addItem(MISSING);
-            } else {
-                dagStructureEntropy.addItem(IMPLICIT);
+/// Entropy coders for the streams of a Top DAG. VARINT_CODER is only available for the pointers,
+/// which it stores as offsets relative to the next node ID, Stream VByte-coded. FRONT_CODER is
+/// only available for the labels, which it stores as a sorted front-coded dictionary.
+enum StreamCoder { HUFFMAN_CODER = 0, RANS_CODER = 1, VARINT_CODER = 2, FRONT_CODER = 3 };
+
+/// Which entropy coder to use for each of DagEntropy's streams
+struct StreamCoders {
+    StreamCoders(const StreamCoder coder = HUFFMAN_CODER)
+        : labels(coder), structure(coder), merges(coder), pointers(coder) {}
+
+    /// Parse one letter per stream (labels, structure, merge types, pointers), 'h' for Huffman,
+    /// 'r' for rANS, for the pointers only 'v' for Stream VByte, and for the labels only 'f'
+    /// for front coding, e.g. "frrv"
+    /// \return whether the specification was valid
+    bool parse(const std::string &spec) {
+        if (spec.size() != 4) return false;
+        StreamCoder *coders[] = {&labels, &structure, &merges, &pointers};
+        for (uint i = 0; i < spec.size(); ++i) {
+            const size_t pos = std::string(letters).find(spec[i]);
+            if (pos == std::string::npos || (pos == VARINT_CODER && coders[i] != &pointers) ||
+                (pos == FRONT_CODER && coders[i] != &labels)) {
+                return false;
             }
-        });
-
-        // nodeId starts at 2 because 0 is a dummy node, we don't need to code it,
-        // and 1 is the tree's root, but we know that, so we don't need to code it.
-        for (uint nodeId = 2; nodeId < dag.nodes.size(); ++nodeId) {
-            // DAG node is coded as the IDs of its children, its own ID
-            // is implicit from the position in the output it appears in
-
-            const DagNode<DataType> &node(dag.nodes[nodeId]);
+            *coders[i] = (StreamCoder)pos;
+        }
+        return true;
+    }
 
-            assert((node.left < 0) == (node.right < 0));
-            if (node.left < 0) {
-                // leaves are not coded here, they were coded before
-                assert(node.label != NULL);
-                assert(node.mergeType == NO_MERGE);
-                continue;
-            }
+    std::string toString() const {
+        std::string result;
+        for (const StreamCoder coder : {labels, structure, merges, pointers}) {
+            result.push_back(letters[coder]);
+        }
+        return result;
+    }
 
-            assert(node.label == NULL);
-            assert(node.mergeType != NO_MERGE);
+    /// Whether all streams use the same coder
+    bool all(const StreamCoder coder) const {
+        return labels == coder && structure == coder && merges == coder && pointers == coder;
+    }
 
-            // We need to code the merge type regardless of the nature of the children
-            mergeEntropy.addItem((char)dag.nodes[nodeId].mergeType);
+    /// The name of a coder, e.g., for verbose output
+    static const char *name(const StreamCoder coder) {
+        static const char *const names[] = {"Huffman", "rANS", "Stream VByte", "front coding"};
+        return names[coder];
+    }
 
-            // if both children are leaves / pointers, they don't need to be coded in the structure
-            if (!isLeafOrPointer(node.left) || !isLeafOrPointer(node.right)) {
-                codeStructure(node.left);
-                codeStructure(node.right);
-            }
+    /// The letter of each coder, by StreamCoder value
+    static constexpr const char *letters = "hrvf";
 
-            if (isLeafOrPointer(node.left)) {
-                dagPointerEntropy.addItem(node.left);
-            }
-            if (isLeafOrPointer(node.right)) {
-                dagPointerEntropy.addItem(node.right);
-            }
+    StreamCoder labels, structure, merges, pointers;
+};
 
-            alreadyVisited[node.left] = true;
-            alreadyVisited[node.right] = true;
+/// Calculate the different entropies of a TopDag - its structure, its merge types, and its labels -
+/// and write them with a BitWriter.
+/**
+ * The DAG's leaves come first (IDs 1 to #leaves) and are only coded through their labels.
+ * The inner nodes are coded in a depth-first traversal from the root. For each node, we code
+ * its merge type and, for each child, whether it is coded right here (IMPLICIT) or was coded
+ * before (MISSING). In the latter case, the child's ID goes into the pointer stream. Inner nodes
+ * are numbered in the order in which their coding is completed (i.e., post-order), starting after
+ * the leaves, so that a decoder can rebuild the DAG with the same IDs, see FileReader.
+ *
+ * Each stream is coded either with Huffman codes or with rANS (see StreamCoders),
+ * which code the structure and merge types in the same blocks. Alternatively, the pointers
+ * can be stored as the difference between the next new ID and the child's new ID, which is
+ * small for the many pointers to recently coded nodes, with Stream VByte. This is larger
+ * than the entropy coders' output, but much faster to decode. If the labels are front-coded,
+ * the leaves are renumbered in the order of their sorted labels.
+ *
+ * The streams are independent of each other: each is modelled and encoded into its own
+ * buffer in its own thread, and a decoder can decode them in parallel, too.
+ */
+template <typename DataType>
+struct DagEntropy {
+    DagEntropy(const TopDag<DataType> &dag, BitWriter &writer, const StreamCoders &coders = StreamCoders()) :
+        dagStructureEntropy(),
+        dagPointerEntropy(),
+        mergeEntropy(),
+        labelDataEntropy(dag),
+        writer(writer),
+        labelOut(),
+        structureOut(),
+        mergeOut(),
+        pointerOut(),
+        dagStructureWriter(dagStructureEntropy.huffman, structureOut),
+        dagPointerWriter(dagPointerEntropy, pointerOut),
+        mergeWriter(mergeEntropy.huffman, mergeOut),
+        labelWriter(labelDataEntropy.huffman, labelOut),
+        dagStructureRans(structureOut),
+        dagPointerRans(pointerOut),
+        mergeRans(mergeOut),
+        labelRans(labelOut),
+        dagPointerVarint(pointerOut),
+        labelFrontCoding(labelOut),
+        coders(coders),
+        dag(dag),
+        structure(),
+        mergeTypes(),
+        pointers(),
+        numLeaves(0)
+    {
+        while (numLeaves + 1 < (int)dag.nodes.size() && dag.nodes[numLeaves + 1].left < 0) {
+            ++numLeaves;
         }
-
-        dagStructureEntropy.flushQueue();
-        mergeEntropy.flushQueue();
-        dagStructureEntropy.huffman.construct();
-        dagPointerEntropy.construct();
-        mergeEntropy.huffman.construct();
-        labelDataEntropy.construct();
     }
 
-    /// Write the stuff to huffman writers
-    void write() {
-        vector<bool> alreadyVisited(dag.nodes.size(), false);
-
-        const auto isLeafOrPointer([&](const int nodeId) {
-            assert((dag.nodes[nodeId].left < 0) == (dag.nodes[nodeId].right < 0));
-            return (alreadyVisited[nodeId] || dag.nodes[nodeId].left < 0);
+    /// Gather the DAG's structure, pointers and merge types, and do the entropy calculations
+    /// on all streams concurrently
+    void calculate() {
+        codeDag();
+
+        runInParallel({
+            [this]() {
+                dagStructureEntropy.addItems(structure.cbegin(), structure.cend());
+                dagStructureEntropy.flushQueue();
+                dagStructureEntropy.huffman.construct();
+            },
+            [this]() {
+                dagPointerEntropy.addItems(pointers.cbegin(), pointers.cend());
+                dagPointerEntropy.construct();
+            },
+            [this]() {
+                mergeEntropy.addItems(mergeTypes.cbegin(), mergeTypes.cend());
+                mergeEntropy.flushQueue();
+                mergeEntropy.huffman.construct();
+            },
+            [this]() { labelDataEntropy.construct(); }
         });
+    }
 
-        // Add structure and label information for a **child** of the current node
-        const auto codeStructure([&](const int nodeId) {
-            assert(nodeId >= 0);
-            if (isLeafOrPointer(nodeId)) {
-                dagStructureWriter.addItem(MISSING);
-            } else {
-                dagStructureWriter.addItem(IMPLICIT);
-            }
+    /// Encode the streams concurrently, each into its own buffer, and write them to the writer.
+    /// Need to have called calculate() before.
+    /**
+     * First come the sizes of the label, structure, merge type and pointer streams in bytes
+     * (32 bits each), then the streams themselves in this order. Each starts with its Huffman
+     * table or rANS model, the pointer stream with the number of pointers (32 bits) before that.
+     */
+    void write() {
+        runInParallel({
+            [this]() { writeLabels(); },
+            [this]() { writeStructure(); },
+            [this]() { writeMerges(); },
+            [this]() { writePointers(); }
         });
 
-        // nodeId starts at 2 because 0 is a dummy node, we don't need to code it,
-        // and 1 is the tree's root, but we know that, so we don't need to code it.
-        for (uint nodeId = 2; nodeId < dag.nodes.size(); ++nodeId) {
-            // DAG node is coded as the IDs of its children, its own ID
-            // is implicit from the position in the output it appears in
-
-            const DagNode<DataType> &node(dag.nodes[nodeId]);
-
-            assert((node.left < 0) == (node.right < 0));
-            if (node.left < 0) {
-                // leaves are not coded here, they were coded before
-                assert(node.label != NULL);
-                assert(node.mergeType == NO_MERGE);
-                continue;
-            }
-
-            assert(node.label == NULL);
-            assert(node.mergeType != NO_MERGE);
-
-            // We need to code the merge type regardless of the nature of the children
-            mergeWriter.addItem((char)dag.nodes[nodeId].mergeType);
-
-            // if both children are leaves / pointers, they don't need to be coded in the structure
-            if (!isLeafOrPointer(node.left) || !isLeafOrPointer(node.right)) {
-                codeStructure(node.left);
-                codeStructure(node.right);
-            }
+        for (const BitWriter *out : {&labelOut, &structureOut, &mergeOut, &pointerOut}) {
+            writer.writeBits(out->getData().size(), 32);
+        }
+        for (const BitWriter *out : {&labelOut, &structureOut, &mergeOut, &pointerOut}) {
+            writer.writeBytes(out->getData());
+        }
+        writer.write();
+    }
 
-            if (isLeafOrPointer(node.left)) {
-                dagPointerWriter.addItem(node.left);
-            }
-            if (isLeafOrPointer(node.right)) {
-                dagPointerWriter.addItem(node.right);
-            }
+    /// The number of leaves in the DAG
+    int getNumLeaves() const {
+        return numLeaves;
+    }
 
-            alreadyVisited[node.left] = true;
-            alreadyVisited[node.right] = true;
-        }
+    /// The number of inner nodes in the DAG
+    int getNumInnerNodes() const {
+        return (int)dag.nodes.size() - 1 - numLeaves;
+    }
 
-        dagStructureWriter.writeBuffer();
-        dagPointerWriter.writeBuffer();
-        mergeWriter.writeBuffer();
-        labelDataEntropy.addToWriter(labelWriter);
-        labelWriter.writeBuffer();
-        writer.write();
+    /// The number of bits used for a pointer in the pointer stream's Huffman table
+    int getBitsPerPointer() const {
+        return bitsFor(dag.nodes.size());
     }
 
     /// Retrieve total size for a Huffman-based encoding of the Top DAG
     long long getTotalSize() const {
-        // Code dag pointers as fixed-length ints
-        // Size can be deduced from decoded dag structure data
-        long long bits_per_pointer = log_2(dag.nodes.size());
+        // the tables' symbols are fixed-length ints of the sizes that write() uses
         long long bits =
             // node IDs are implicit, but we need to encode the blocked huffman's table (it's quite small)
-            dagStructureEntropy.huffman.getBitsNeeded() + dagStructureEntropy.huffman.getBitsForTableLabels() +
+            dagStructureEntropy.huffman.getBitsNeeded() + dagStructureEntropy.huffman.getBitsForTableLabels(8) +
             // pointers are not implicit, need to store them
-            dagPointerEntropy.getBitsNeeded() + dagPointerEntropy.getNumSymbols() * bits_per_pointer +
+            dagPointerEntropy.getBitsNeeded() + dagPointerEntropy.getBitsForTableLabels(getBitsPerPointer()) +
             // merge type needs a mapping as well (it's tiny anyway)
-            mergeEntropy.huffman.getBitsNeeded() + mergeEntropy.huffman.getBitsForTableLabels() +
+            mergeEntropy.huffman.getBitsNeeded() + mergeEntropy.huffman.getBitsForTableLabels(16) +
             // label strings do need a kind of a table
             labelDataEntropy.huffman.getBitsNeeded() + labelDataEntropy.getExtraSize() +
-            // lengths of each data segment, except for the last, as 32 bit ints
-            // we don't need to code the length of the pointer table (we can infer that from the decoded dag structure),
-            // nor for the dag structure or merge entropy (we can count the number of symbols encountered and know the
-            // size of each).
-            4*sizeof(int)*8;
+            // lengths of the four streams, and the number of pointers, as 32 bit ints
+            5*sizeof(int)*8;
         return bits;
     }
 
@@ -323,10 +349,128 @@ struct DagEntropy {
     LabelDataEntropy<DataType> labelDataEntropy;
 
     BitWriter &writer;
+    /// the buffers the streams are encoded into
+    BitWriter labelOut, structureOut, mergeOut, pointerOut;
+
     BlockedHuffmanWriter<bool, uint8_t, 1, 8> dagStructureWriter;
     HuffmanWriter<int> dagPointerWriter;
     BlockedHuffmanWriter<char, uint16_t, 4, 16> mergeWriter;
     HuffmanWriter<std::string::value_type> labelWriter;
 
+    BlockedRansWriter<bool, uint8_t, 1, 8> dagStructureRans;
+    RansWriter<int> dagPointerRans;
+    BlockedRansWriter<char, uint16_t, 4, 16> mergeRans;
+    RansWriter<std::string::value_type> labelRans;
+    StreamVByteWriter dagPointerVarint;
+    FrontCodingWriter labelFrontCoding;
+
+    const StreamCoders coders;
     const TopDag<DataType> &dag;
+
+protected:
+    void writeLabels() {
+        if (coders.labels == RANS_CODER) {
+            labelDataEntropy.addToWriter(labelRans);
+            labelRans.writeBuffer();
+        } else if (coders.labels == FRONT_CODER) {
+            labelDataEntropy.addSortedToWriter(labelFrontCoding);
+            labelFrontCoding.writeBuffer();
+        } else {
+            labelDataEntropy.huffman.writeTable(labelOut, sizeof(std::string::value_type) * 8);
+            labelDataEntropy.addToWriter(labelWriter);
+            labelWriter.writeBuffer();
+        }
+        labelOut.write();
+    }
+
+    void writeStructure() {
+        if (coders.structure == RANS_CODER) {
+            dagStructureRans.addItems(structure.cbegin(), structure.cend());
+            dagStructureRans.writeBuffer();
+        } else {
+            dagStructureEntropy.huffman.writeTable(structureOut, 8);
+            dagStructureWriter.addItems(structure.cbegin(), structure.cend());
+            dagStructureWriter.writeBuffer();
+        }
+        structureOut.write();
+    }
+
+    void writeMerges() {
+        if (coders.merges == RANS_CODER) {
+            mergeRans.addItems(mergeTypes.cbegin(), mergeTypes.cend());
+            mergeRans.writeBuffer();
+        } else {
+            mergeEntropy.huffman.writeTable(mergeOut, 16);
+            mergeWriter.addItems(mergeTypes.cbegin(), mergeTypes.cend());
+            mergeWriter.writeBuffer();
+        }
+        mergeOut.write();
+    }
+
+    void writePointers() {
+        pointerOut.writeBits(pointers.size(), 32);
+        if (coders.pointers == RANS_CODER) {
+            dagPointerRans.addItems(pointers.cbegin(), pointers.cend());
+            dagPointerRans.writeBuffer();
+        } else if (coders.pointers == VARINT_CODER) {
+            dagPointerVarint.addItems(pointers.cbegin(), pointers.cend());
+            dagPointerVarint.writeBuffer();
+        } else {
+            dagPointerEntropy.writeTable(pointerOut, getBitsPerPointer());
+            dagPointerWriter.addItems(pointers.cbegin(), pointers.cend());
+            dagPointerWriter.writeBuffer();
+        }
+        pointerOut.write();
+    }
+
+    /// Gather the DAG's structure, pointers and merge types in coding order. Pointers are
+    /// relative (next new ID minus the child's new ID) if they are coded with VARINT_CODER.
+    void codeDag() {
+        const bool relativePointers = (coders.pointers == VARINT_CODER);
+        // new IDs in the order of coding, 0 = not coded yet. Leaves keep their IDs, unless
+        // their labels are front-coded in sorted order.
+        vector<int> newIds(dag.nodes.size(), 0);
+        if (coders.labels == FRONT_CODER) {
+            const vector<int> leaves(labelDataEntropy.getSortedLeaves());
+            for (int i = 0; i < numLeaves; ++i) {
+                newIds[leaves[i]] = i + 1;
+            }
+        } else {
+            for (int nodeId = 1; nodeId <= numLeaves; ++nodeId) {
+                newIds[nodeId] = nodeId;
+            }
+        }
+        int nextId(numLeaves + 1);
+        structure.clear();
+        mergeTypes.clear();
+        pointers.clear();
+
+        const std::function<void (const int)> codeNode([&](const int nodeId) {
+            const DagNode<DataType> &node(dag.nodes[nodeId]);
+            assert(node.left >= 0 && node.right >= 0);
+            assert(node.label == NULL);
+            assert(node.mergeType != NO_MERGE);
+
+            mergeTypes.push_back((char)node.mergeType);
+            for (const int child : {node.left, node.right}) {
+                if (newIds[child] > 0) {
+                    // a leaf, or coded before
+                    structure.push_back(MISSING);
+                    pointers.push_back(relativePointers ? nextId - newIds[child] : newIds[child]);
+                } else {
+                    structure.push_back(IMPLICIT);
+                    codeNode(child);
+                }
+            }
+            newIds[nodeId] = nextId++;
+        });
+        codeNode(dag.nodes.size() - 1);
+        assert(nextId == (int)dag.nodes.size());
+    }
+
+    /// the streams in coding order
+    vector<bool> structure;
+    vector<char> mergeTypes;
+    vector<int> pointers;
+    int numLeaves;
 };
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BitReader.h"
+#include "Entropy.h"
+#include "FileWriter.h"
+#include "FrontCoding.h"
+#include "Huffman.h"
+#include "Labels.h"
+#include "Timer.h"
+#include "TopDag.h"
+
+/// Read a Top DAG from a file written by FileWriter
+/**
+ * Usage: read the labels first, construct a TopDag with getNumLeaves() leaves
+ * and these labels, then read the DAG's inner nodes into it.
+ *
+ * The structure, merge type and pointer streams are decoded in background threads
+ * that are started when the labels are read, so all four streams are decoded in
+ * parallel.
+ */
+class FileReader {
+public:
+    /// Open a file and read its header
+    FileReader(const std::string &fn)
+        : reader(fn), labelReader(), structureReader(), mergeReader(), pointerReader(), ok(false),
+          numTreeNodes(0), numLeaves(0), numInnerNodes(0), coders(), structure(), mergeTypes(), pointers(),
+          structureOk(false), mergesOk(false), pointersOk(false), dagStreamDecoders() {
+        if (!reader.good() || reader.readBits(32) != TOPDAG_FILE_MAGIC || reader.readBits(32) != TOPDAG_FILE_VERSION) {
+            return;
+        }
+        numTreeNodes = reader.readBits(32);
+        numLeaves = reader.readBits(32);
+        numInnerNodes = reader.readBits(32);
+        ok = !reader.overrun() && numLeaves > 0 && numInnerNodes > 0;
+        for (StreamCoder *coder : {&coders.labels, &coders.structure, &coders.merges, &coders.pointers}) {
+            const uint64_t value = reader.readBits(8);
+            ok = ok && (value == HUFFMAN_CODER || value == RANS_CODER ||
+                        (value == VARINT_CODER && coder == &coders.pointers) ||
+                        (value == FRONT_CODER && coder == &coders.labels));
+            *coder = (StreamCoder)value;
+        }
+
+        // Split the rest of the file into the streams, see DagEntropy::write()
+        uint64_t sizes[4], totalSize(0);
+        for (uint64_t &size : sizes) {
+            size = reader.readBits(32);
+            totalSize += size;
+        }
+        ok = ok && !reader.overrun() && totalSize == reader.bytesLeft();
+        if (!ok) return;
+        const unsigned char *begin = reader.bytes();
+        BitReader *streams[] = {&labelReader, &structureReader, &mergeReader, &pointerReader};
+        for (int i = 0; i < 4; ++i) {
+            *streams[i] = BitReader(begin, begin + sizes[i]);
+            begin += sizes[i];
+        }
+    }
+
+    ~FileReader() {
+        finishDecodingDagStreams();
+    }
+
+    /// Whether everything read so far was valid
+    bool good() const {
+        return ok;
+    }
+
+    /// Read the leaves' labels. Call this first.
+    /// \param labels output labels, label i will belong to the DAG's i+1-th node
+    /// \return whether the labels could be read
+    bool readLabels(Labels<std::string> &labels) {
+        startDecodingDagStreams();
+        if (coders.labels == RANS_CODER) {
+            RansReader<std::string::value_type> rans;
+            ok = ok && rans.readTable(labelReader);
+            ok = ok && readLabels(labels, rans) && rans.finish();
+        } else if (coders.labels == FRONT_CODER) {
+            FrontCodedLabels dictionary;
+            ok = ok && readLabels(dictionary);
+            for (int i = 0; ok && i < numLeaves; ++i) {
+                labels.set(i, dictionary[i]);
+            }
+        } else {
+            HuffmanReader<std::string::value_type> huffman;
+            ok = ok && huffman.readTable(labelReader, sizeof(std::string::value_type) * 8);
+            ok = ok && readLabels(labels, huffman) && !huffman.hadError();
+        }
+        return ok;
+    }
+
+    /// Read front-coded labels without decoding them, see FrontCodedLabels. Call this first,
+    /// and only if getStreamCoders().labels is FRONT_CODER.
+    /// \return whether the labels could be read
+    bool readLabels(FrontCodedLabels &labels) {
+        startDecodingDagStreams();
+        ok = ok && coders.labels == FRONT_CODER && labels.read(labelReader, numLeaves);
+        return ok;
+    }
+
+    /// Read the DAG's inner nodes
+    /// \param dag a TopDag constructed with getNumLeaves() leaves with the labels from readLabels()
+    /// \return whether the DAG could be read
+    template <typename DataType>
+    bool readDag(TopDag<DataType> &dag) {
+        startDecodingDagStreams();
+        finishDecodingDagStreams();
+        ok = ok && structureOk && mergesOk && pointersOk;
+        if (!ok || (int)dag.nodes.size() != numLeaves + 1) {
+            return ok = false;
+        }
+
+        // Rebuild the DAG in the order it was coded in, see DagEntropy
+        const bool relativePointers = (coders.pointers == VARINT_CODER);
+        const int maxNodeId = numLeaves + numInnerNodes;
+        size_t structurePos(0), mergePos(0), pointerPos(0);
+        const std::function<int (void)> decodeNode([&]() {
+            if (mergePos >= mergeTypes.size() || mergeTypes[mergePos] < 0 || mergeTypes[mergePos] > HORZ_NO_BBN) {
+                ok = false;
+                return 1;
+            }
+            const MergeType mergeType = (MergeType)mergeTypes[mergePos++];
+            int children[2];
+            for (int &child : children) {
+                if (!ok || structurePos >= structure.size()) {
+                    ok = false;
+                    return 1;
+                }
+                if (structure[structurePos++] == MISSING) {
+                    if (pointerPos >= pointers.size()) {
+                        ok = false;
+                        return 1;
+                    }
+                    child = pointers[pointerPos++];
+                    if (relativePointers) {
+                        child = (int)dag.nodes.size() - child;
+                    }
+                    // pointers can only go to nodes that were completed before
+                    if (child <= 0 || child >= (int)dag.nodes.size()) {
+                        ok = false;
+                        return 1;
+                    }
+                } else {
+                    child = decodeNode();
+                }
+            }
+            return dag.addNode(children[0], children[1], mergeType);
+        });
+        decodeNode();
+        ok = ok && ((int)dag.nodes.size() == maxNodeId + 1) && (pointerPos == pointers.size());
+        return ok;
+    }
+
+    /// The number of nodes in the tree represented by the DAG
+    int getNumTreeNodes() const {
+        return numTreeNodes;
+    }
+
+    /// The number of leaves in the DAG
+    int getNumLeaves() const {
+        return numLeaves;
+    }
+
+    /// The number of inner nodes in the DAG
+    int getNumInnerNodes() const {
+        return numInnerNodes;
+    }
+
+    /// The size of the file in bytes
+    size_t getFileSize() const {
+        return reader.size();
+    }
+
+    /// The entropy coders used for the streams
+    const StreamCoders &getStreamCoders() const {
+        return coders;
+    }
+
+protected:
+    /// Decode zero-terminated labels with a HuffmanReader or RansReader
+    template <typename Decoder>
+    bool readLabels(Labels<std::string> &labels, Decoder &decoder) {
+        std::string label;
+        for (int i = 0; i < numLeaves; ) {
+            const char c = decoder.decode(labelReader);
+            if (c == 0) {
+                labels.set(i++, label);
+                label.clear();
+            } else {
+                label.push_back(c);
+            }
+            if (labelReader.overrun()) return false;
+        }
+        return true;
+    }
+
+    /// Start decoding the structure, merge type and pointer streams, one thread each (once)
+    void startDecodingDagStreams() {
+        if (!ok || !dagStreamDecoders.empty()) return;
+        dagStreamDecoders.push_back(std::thread([this]() { structureOk = decodeStructure(); }));
+        dagStreamDecoders.push_back(std::thread([this]() { mergesOk = decodeMerges(); }));
+        dagStreamDecoders.push_back(std::thread([this]() { pointersOk = decodePointers(); }));
+    }
+
+    /// Wait for the threads started by startDecodingDagStreams()
+    void finishDecodingDagStreams() {
+        for (std::thread &decoder : dagStreamDecoders) {
+            if (decoder.joinable()) {
+                decoder.join();
+            }
+        }
+    }
+
+    bool decodeStructure() {
+        bool success;
+        structure.reserve(2 * numInnerNodes);
+        if (coders.structure == RANS_CODER) {
+            BlockedRansReader<bool, uint8_t, 1, 8> rans;
+            success = rans.readTable(structureReader);
+            if (success) rans.decode(structureReader, 2 * numInnerNodes, structure);
+            success = success && rans.finish();
+        } else {
+            BlockedHuffmanReader<bool, uint8_t, 1, 8> huffman;
+            success = huffman.readTable(structureReader);
+            if (success) huffman.decode(structureReader, 2 * numInnerNodes, structure);
+            success = success && !huffman.hadError();
+        }
+        return success && !structureReader.overrun();
+    }
+
+    bool decodeMerges() {
+        bool success;
+        mergeTypes.reserve(numInnerNodes);
+        if (coders.merges == RANS_CODER) {
+            BlockedRansReader<char, uint16_t, 4, 16> rans;
+            success = rans.readTable(mergeReader);
+            if (success) rans.decode(mergeReader, numInnerNodes, mergeTypes);
+            success = success && rans.finish();
+        } else {
+            BlockedHuffmanReader<char, uint16_t, 4, 16> huffman;
+            success = huffman.readTable(mergeReader);
+            if (success) huffman.decode(mergeReader, numInnerNodes, mergeTypes);
+            success = success && !huffman.hadError();
+        }
+        return success && !mergeReader.overrun();
+    }
+
+    bool decodePointers() {
+        // every inner node has two children, each of which is either implicit or a pointer
+        const uint64_t numPointers = pointerReader.readBits(32);
+        if (pointerReader.overrun() || numPointers > 2 * (uint64_t)numInnerNodes) return false;
+        bool success;
+        pointers.reserve(numPointers);
+        if (coders.pointers == RANS_CODER) {
+            RansReader<int> rans;
+            success = rans.readTable(pointerReader);
+            if (success) rans.decode(pointerReader, numPointers, pointers);
+            success = success && rans.finish();
+        } else if (coders.pointers == VARINT_CODER) {
+            success = StreamVByteReader::decode(pointerReader, numPointers, pointers);
+        } else {
+            HuffmanReader<int> huffman;
+            success = huffman.readTable(pointerReader, bitsFor(numLeaves + numInnerNodes + 1));
+            if (success) huffman.decode(pointerReader, numPointers, pointers);
+            success = success && !huffman.hadError();
+        }
+        return success && !pointerReader.overrun();
+    }
+
+    /// the whole file, and the label, structure, merge type and pointer streams
+    BitReader reader, labelReader, structureReader, mergeReader, pointerReader;
+    bool ok;
+    int numTreeNodes, numLeaves, numInnerNodes;
+    StreamCoders coders;
+
+    /// the decoded streams, see decodeStructure(), decodeMerges() and decodePointers()
+    vector<bool> structure;
+    vector<char> mergeTypes;
+    vector<int> pointers;
+    bool structureOk, mergesOk, pointersOk;
+    std::vector<std::thread> dagStreamDecoders;
+};
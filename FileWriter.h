@@ -1,34 +1,104 @@
 #pragma once
 
 #include <iostream>
+#include <string>
+#include <vector>
 
-#include "FileWriter.h"
+#include "BitWriter.h"
+#include "Entropy.h"
 #include "Timer.h"
-#include "TreeSizeEstimation.h"
+#include "TopDag.h"
 
-/// UNFINISHED Top DAG writer. Don't use.
+using std::endl;
+
+/// Identifies Top DAG files ("TDAG")
+static const uint32_t TOPDAG_FILE_MAGIC = 0x54444147;
+/// Version of the Top DAG file format
+static const uint32_t TOPDAG_FILE_VERSION = 4;
+
+/// Write a Top DAG to a file
+/**
+ * The file starts with a header of 32-bit fields: magic number, format version,
+ * number of nodes in the represented tree, number of leaves and of inner nodes
+ * in the DAG, and the entropy coders of the streams (one byte per stream, see
+ * StreamCoder). It is followed by the sizes of the label, structure, merge type
+ * and pointer streams and the streams themselves, as written by DagEntropy::write().
+ */
 class FileWriter {
 public:
+    /// Write a Top DAG
+    /// \param dag the Top DAG to write, whose leaves must come first
+    /// \param fn output filename
+    /// \param verbose whether to print the sizes of the streams
+    /// \param coders the entropy coder to use for each stream
+    /// \return the size of the file in bits, or -1 if it could not be written
     template <typename DataType>
-    static long long write(const TopDag<DataType> &dag, const Labels<DataType> &labels, const std::string &fn, const bool verbose = true) {
+    static long long write(const TopDag<DataType> &dag, const std::string &fn, const bool verbose = true,
+                           const StreamCoders &coders = StreamCoders()) {
         Timer timer;
 
         BitWriter writer(fn);
-        DagEntropy<DataType> entropy(dag, labels, writer);
+        if (!writer.good()) {
+            return -1;
+        }
+        DagEntropy<DataType> entropy(dag, writer, coders);
         entropy.calculate();
 
-        if (verbose) std::cout
-             << "DAG Structure: " << entropy.dagStructureEntropy.huffman << endl
-             << "DAG Pointers:  " << entropy.dagPointerEntropy << endl
-             << "Merge Types:   " << entropy.mergeEntropy.huffman << endl
-             << "Label strings: " << entropy.labelDataEntropy.huffman << " + " << entropy.labelDataEntropy.getExtraSize() << " bits for symbols" << endl
-             << "Huffman calcuation took " << timer.getAndReset() << "ms; " << endl;
+        if (verbose) {
+            // the Huffman codes are only of interest for the streams that use them
+            printCoder(std::cout << "DAG Structure: ", coders.structure, entropy.dagStructureEntropy.huffman) << endl;
+            printCoder(std::cout << "DAG Pointers:  ", coders.pointers, entropy.dagPointerEntropy) << endl;
+            printCoder(std::cout << "Merge Types:   ", coders.merges, entropy.mergeEntropy.huffman) << endl;
+            printCoder(std::cout << "Label strings: ", coders.labels, entropy.labelDataEntropy.huffman);
+            if (coders.labels == HUFFMAN_CODER) {
+                std::cout << " + " << entropy.labelDataEntropy.getExtraSize() << " bits for symbols";
+            }
+            std::cout << endl << "Entropy calculation took " << timer.getAndReset() << "ms; " << endl;
+        }
 
-        //entropy.write();
+        writer.writeBits(TOPDAG_FILE_MAGIC, 32);
+        writer.writeBits(TOPDAG_FILE_VERSION, 32);
+        writer.writeBits(countTreeNodes(dag), 32);
+        writer.writeBits(entropy.getNumLeaves(), 32);
+        writer.writeBits(entropy.getNumInnerNodes(), 32);
+        for (const StreamCoder coder : {coders.labels, coders.structure, coders.merges, coders.pointers}) {
+            writer.writeBits(coder, 8);
+        }
+        entropy.write();
         writer.close();
 
-        //if (verbose) std::cout << "Wrote a total of " << writer.getBytesWritten() << " Bytes (" << writer.getBytesWritten()*8 << " bits) to " << fn << endl;
+        if (verbose) {
+            std::cout << "Wrote a total of " << writer.getBytesWritten() << " Bytes (" << writer.getBytesWritten()*8 << " bits";
+            // getTotalSize() estimates the size with Huffman codes only
+            if (coders.all(HUFFMAN_CODER)) {
+                std::cout << ", estimate was " << entropy.getTotalSize();
+            }
+            std::cout << ") to " << fn << " in " << timer.getAndReset() << "ms" << endl;
+        }
+
+        return writer.getBytesWritten() * 8;
+    }
 
-        return entropy.getTotalSize();
+    /// Print a stream's Huffman code if the stream is Huffman-coded, or else the name of its coder
+    template <typename Huffman>
+    static std::ostream &printCoder(std::ostream &os, const StreamCoder coder, const Huffman &huffman) {
+        if (coder == HUFFMAN_CODER) {
+            return os << huffman;
+        }
+        return os << StreamCoders::name(coder);
+    }
+
+    /// The number of nodes of the tree represented by a Top DAG
+    template <typename DataType>
+    static unsigned long long countTreeNodes(const TopDag<DataType> &dag) {
+        std::vector<unsigned long long> sizes(dag.nodes.size(), 1);
+        // children always have smaller IDs than their parents
+        for (uint nodeId = 1; nodeId < dag.nodes.size(); ++nodeId) {
+            const DagNode<DataType> &node = dag.nodes[nodeId];
+            if (node.left >= 0) {
+                sizes[nodeId] = sizes[node.left] + sizes[node.right];
+            }
+        }
+        return sizes.back();
     }
 };
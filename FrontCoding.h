@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "BitReader.h"
+#include "BitWriter.h"
+#include "Labels.h"
+
+/// Front coding of a (mostly) sorted string dictionary
+/**
+ * The strings are split into blocks of blockSize. The first string of a block is
+ * stored in full (its length, then its bytes), every other one as the length of
+ * the prefix it shares with its predecessor, the length of the remaining suffix,
+ * and the suffix's bytes. Lengths are stored as variable-length bytes (7 bits per
+ * byte, least significant first, the highest bit is set on all but the last byte).
+ *
+ * Sorting makes neighbouring strings share long prefixes (e.g., XML namespaces),
+ * and as every block starts with a full string, a string can be decoded from the
+ * start of its block alone.
+ */
+struct FrontCoding {
+    static const unsigned int blockSize = 16;
+
+    /// Append a variable-length number to a byte vector
+    static void appendLength(std::vector<unsigned char> &bytes, uint64_t value) {
+        while (value >= 0x80) {
+            bytes.push_back((unsigned char)(value | 0x80));
+            value >>= 7;
+        }
+        bytes.push_back((unsigned char)value);
+    }
+
+    /// Read a variable-length number
+    /// \param pos position of the number, advanced beyond it
+    /// \param end end of the input
+    /// \param value output value
+    /// \return whether the number was complete
+    static bool readLength(const unsigned char *&pos, const unsigned char *end, uint64_t &value) {
+        value = 0;
+        for (unsigned int shift = 0; pos < end && shift < 64; shift += 7) {
+            const unsigned char byte = *pos++;
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if (byte < 0x80) return true;
+        }
+        return false;
+    }
+
+    /// The length of the longest common prefix of two strings
+    static size_t commonPrefix(const std::string &a, const std::string &b) {
+        const size_t length = std::min(a.size(), b.size());
+        size_t i(0);
+        while (i < length && a[i] == b[i]) {
+            ++i;
+        }
+        return i;
+    }
+};
+
+/// Front-codes strings and writes them to a BitWriter, see FrontCoding
+/**
+ * The stream starts at a byte boundary with the number of bytes (32 bits) that follow.
+ * The number of strings is not stored, the reader needs to know it.
+ */
+class FrontCodingWriter {
+public:
+    FrontCodingWriter(BitWriter &writer) : writer(writer), bytes(), previous(), numItems(0) {}
+
+    /// Add the next string. Any order works, but sorted strings share longer prefixes.
+    void addItem(const std::string &label) {
+        if (numItems % FrontCoding::blockSize == 0) {
+            FrontCoding::appendLength(bytes, label.size());
+            bytes.insert(bytes.end(), label.cbegin(), label.cend());
+        } else {
+            const size_t prefix = FrontCoding::commonPrefix(previous, label);
+            FrontCoding::appendLength(bytes, prefix);
+            FrontCoding::appendLength(bytes, label.size() - prefix);
+            bytes.insert(bytes.end(), label.cbegin() + prefix, label.cend());
+        }
+        previous = label;
+        ++numItems;
+    }
+
+    /// Write the coded strings and clear the buffer
+    void writeBuffer() {
+        writer.alignToByte();
+        writer.writeBits(bytes.size(), 32);
+        writeBytes();
+    }
+
+    /// Write the coded strings without their number of bytes (see getNumBytes()), e.g.,
+    /// if the caller stores that in a different format, and clear the buffer
+    void writeBytes() {
+        for (const unsigned char byte : bytes) {
+            writer.writeBits(byte, 8);
+        }
+        bytes.clear();
+        previous.clear();
+        numItems = 0;
+    }
+
+    /// The number of bytes writeBuffer() will write (without the padding)
+    size_t getBytesNeeded() const {
+        return 4 + bytes.size();
+    }
+
+    /// The number of bytes of the coded strings so far
+    size_t getNumBytes() const {
+        return bytes.size();
+    }
+
+protected:
+    BitWriter &writer;
+    std::vector<unsigned char> bytes;
+    std::string previous;
+    size_t numItems;
+};
+
+/// Labels backed by a front-coded dictionary written by FrontCodingWriter
+/**
+ * Only the coded bytes and the offset of each block (the sampled index) are kept
+ * after reading. A label is decoded together with the rest of its block when it
+ * is first accessed, so access takes time linear in the size of its block.
+ * Each block is decoded exactly once (see std::call_once), so the labels can be
+ * accessed from several threads concurrently. They are read-only.
+ *
+ * Instead of copying the coded bytes, the labels can also use bytes that stay in
+ * memory elsewhere, e.g., in a memory-mapped file (see map()).
+ */
+class FrontCodedLabels : public LabelsT<std::string> {
+public:
+    FrontCodedLabels()
+        : bytes(), external(NULL), numBytes(0), blockOffsets(), labels(), blockDecoded(), numLabels(0) {}
+
+    FrontCodedLabels(const FrontCodedLabels &) = delete;
+    FrontCodedLabels &operator=(const FrontCodedLabels &) = delete;
+
+    /// Read `count` labels from a BitReader and index their blocks
+    /// \return whether the input was well-formed
+    bool read(BitReader &reader, const uint count) {
+        reader.alignToByte();
+        const uint64_t length = reader.readBits(32);
+        if (reader.overrun() || reader.bytesLeft() < length) return false;
+        bytes.assign(reader.bytes(), reader.bytes() + length);
+        reader.skipBytes(length);
+        external = NULL;
+        numBytes = bytes.size();
+        return index(count);
+    }
+
+    /// Use `count` labels coded in `length` bytes (without the length written by
+    /// FrontCodingWriter) in place. The bytes must outlive the labels.
+    /// \return whether the input was well-formed
+    bool map(const unsigned char *begin, const size_t length, const uint count) {
+        bytes.clear();
+        external = begin;
+        numBytes = length;
+        return index(count);
+    }
+
+    /// Access a label, decoding its block if necessary
+    const std::string &operator[](uint index) const {
+        assert(index < numLabels);
+        const uint block = index / FrontCoding::blockSize;
+        std::call_once(blockDecoded[block], &FrontCodedLabels::decodeBlock, this, block);
+        return labels[index];
+    }
+
+    /// The labels are read-only, so this fails
+    void set(uint id, const std::string &value) {
+        (void)value;
+        std::cerr << "Can't set label " << id << ", front-coded labels are read-only" << std::endl;
+        std::abort();
+    }
+
+    uint size() const {
+        return numLabels;
+    }
+
+protected:
+    /// The coded bytes, wherever they are
+    const unsigned char *data() const {
+        return external == NULL ? bytes.data() : external;
+    }
+
+    /// Walk over the coded labels to find the blocks and check all lengths
+    bool index(const uint count) {
+        numLabels = count;
+        const uint numBlocks = (count + FrontCoding::blockSize - 1) / FrontCoding::blockSize;
+        labels.assign(count, std::string());
+        blockDecoded.reset(new std::once_flag[numBlocks]);
+        blockOffsets.clear();
+        blockOffsets.reserve(numBlocks);
+
+        const unsigned char *pos = data(), *const end = data() + numBytes;
+        uint64_t previousLength(0);
+        for (uint i = 0; i < count; ++i) {
+            uint64_t prefix(0), suffix(0);
+            if (i % FrontCoding::blockSize == 0) {
+                blockOffsets.push_back(pos - data());
+            } else if (!FrontCoding::readLength(pos, end, prefix) || prefix > previousLength) {
+                return false;
+            }
+            if (!FrontCoding::readLength(pos, end, suffix) || suffix > (uint64_t)(end - pos)) {
+                return false;
+            }
+            pos += suffix;
+            previousLength = prefix + suffix;
+        }
+        return pos == end;
+    }
+
+    /// Decode all labels of a block (whose lengths were checked by index())
+    void decodeBlock(const uint block) const {
+        const unsigned char *pos = data() + blockOffsets[block], *const end = data() + numBytes;
+        const uint first = block * FrontCoding::blockSize;
+        const uint last = std::min(first + FrontCoding::blockSize, numLabels);
+        for (uint i = first; i < last; ++i) {
+            uint64_t prefix(0), suffix(0);
+            if (i > first) {
+                FrontCoding::readLength(pos, end, prefix);
+            }
+            FrontCoding::readLength(pos, end, suffix);
+            std::string &label = labels[i];
+            label.reserve(prefix + suffix);
+            if (i > first) {
+                label.assign(labels[i - 1], 0, prefix);
+            }
+            label.append((const char *)pos, suffix);
+            pos += suffix;
+        }
+    }
+
+    /// the coded bytes if they were copied by read()
+    std::vector<unsigned char> bytes;
+    /// the coded bytes if they are used in place (see map()), or NULL
+    const unsigned char *external;
+    size_t numBytes;
+    /// offset of the first byte of each block
+    std::vector<size_t> blockOffsets;
+    /// the labels of the blocks decoded so far (the others are empty), written only by decodeBlock()
+    mutable std::vector<std::string> labels;
+    /// whether each block was decoded
+    mutable std::unique_ptr<std::once_flag[]> blockDecoded;
+    uint numLabels;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cassert>
+#include <ostream>
+#include <vector>
+
+#include "Nodes.h"
+#include "TopDag.h"
+
+using std::vector;
+
+/// An immutable view of a finished Top DAG that can be shared between threads
+/**
+ * A FrozenTopDag only holds a const copy of the DAG's nodes and has no
+ * mutable state or lazily filled caches, so any number of threads can
+ * navigate it concurrently without synchronisation, each with its own
+ * cursor (see DagCursor in Navigation.h). The labels are referenced by
+ * the nodes, not copied, and must outlive the frozen DAG.
+ */
+template <typename DataType>
+class FrozenTopDag {
+public:
+    /// Freeze a finished Top DAG. The Top DAG can be destroyed afterwards.
+    explicit FrozenTopDag(const TopDag<DataType> &dag) : nodes(dag.nodes) {
+        assert(nodes.size() > 1);
+    }
+
+    FrozenTopDag(const FrozenTopDag &) = delete;
+    FrozenTopDag &operator=(const FrozenTopDag &) = delete;
+
+    /// ID of the root node
+    int root() const {
+        return (int)nodes.size() - 1;
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const FrozenTopDag<DataType> &dag) {
+        os << "Frozen binary Dag with " << dag.nodes.size() - 1 << " nodes";
+        for (uint i = 1; i < dag.nodes.size(); ++i) {
+            os << "; " << i << "=" << dag.nodes[i];
+        }
+        return os;
+    }
+
+    const vector<DagNode<DataType>> nodes;
+};
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+/// Count the occurrences of symbols
+/**
+ * Integral symbols are counted in an array indexed by the symbol's value (as an
+ * unsigned integer), which grows up to maxDenseSize entries as larger symbols
+ * occur, or up to as many entries as there are items if addItems() adds many at
+ * once. Symbols beyond that (e.g., negative ones of types with more than 16 bits),
+ * booleans and non-integral symbols are counted in a hash map. SymbolIds numbers
+ * the symbols the same way, so that looking them up only hashes the latter.
+ *
+ * Adding many items at once with addItems() counts consecutive items in different
+ * sub-histograms that are summed up afterwards, so that runs of the same symbol
+ * don't have to wait for the previous increment's store.
+ */
+template <typename SymbolType,
+          bool dense = std::is_integral<SymbolType>::value && !std::is_same<SymbolType, bool>::value>
+class Histogram;
+
+template <typename SymbolType>
+class Histogram<SymbolType, true> {
+    typedef typename std::make_unsigned<SymbolType>::type UnsignedType;
+public:
+    /// the maximum number of entries in the array, symbols beyond go to the hash map
+    static const size_t maxDenseSize = 1 << 20;
+    /// the number of sub-histograms used by addItems()
+    static const unsigned int numLanes = 4;
+    /// the number of items counted in the lanes before adding them up, so that no lane overflows
+    static const size_t maxItemsPerChunk = (size_t)numLanes << 31;
+    /// addItems() only uses sub-histograms for at least this many items per array entry
+    static const size_t minItemsPerEntry = 2;
+
+    Histogram() : dense(), sparse(), numItems(0), numSymbols(0) {}
+
+    void addItem(const SymbolType &symbol) {
+        const size_t index = (UnsignedType)symbol;
+        if (index >= dense.size() && !grow(index)) {
+            numSymbols += (++sparse[symbol] == 1);
+        } else {
+            numSymbols += (++dense[index] == 1);
+        }
+        ++numItems;
+    }
+
+    template <typename InputIterator>
+    void addItems(InputIterator begin, InputIterator end) {
+        addItems(begin, end, typename std::iterator_traits<InputIterator>::iterator_category());
+    }
+
+    /// The number of occurrences of a symbol
+    uint64_t count(const SymbolType &symbol) const {
+        const size_t index = (UnsignedType)symbol;
+        if (index < dense.size()) {
+            return dense[index];
+        }
+        const auto it = sparse.find(symbol);
+        return it == sparse.end() ? 0 : it->second;
+    }
+
+    /// Call a function with each symbol that occurred and its number of occurrences
+    template <typename Callback>
+    void forEach(const Callback &callback) const {
+        for (size_t index = 0; index < dense.size(); ++index) {
+            if (dense[index] > 0) {
+                callback((SymbolType)index, dense[index]);
+            }
+        }
+        for (auto it = sparse.cbegin(); it != sparse.cend(); ++it) {
+            callback(it->first, it->second);
+        }
+    }
+
+    /// The number of different symbols
+    size_t getNumSymbols() const {
+        return numSymbols;
+    }
+
+    /// The size of the array: symbols whose denseIndex() is smaller are counted there
+    size_t getDenseSize() const {
+        return dense.size();
+    }
+
+    /// The index of a symbol in the array (if it is counted there)
+    static size_t denseIndex(const SymbolType &symbol) {
+        return (UnsignedType)symbol;
+    }
+
+    /// The number of occurrences of all symbols
+    uint64_t getNumItems() const {
+        return numItems;
+    }
+
+    void clear() {
+        dense.clear();
+        sparse.clear();
+        numItems = 0;
+        numSymbols = 0;
+    }
+
+protected:
+    /// Make the array large enough for a symbol, if it may be counted there
+    /// \param maxSize the array may have this many entries, if that is more than maxDenseSize
+    /// \return whether the array is large enough now
+    bool grow(const size_t index, const size_t maxSize = 0) {
+        if (index < maxDenseSize) {
+            size_t size = std::max<size_t>(dense.size(), 256);
+            while (size <= index) {
+                size *= 2;
+            }
+            dense.resize(size, 0);
+        } else if (index < maxSize) {
+            dense.resize(index + 1, 0);
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    template <typename InputIterator>
+    void addItems(InputIterator begin, InputIterator end, std::input_iterator_tag) {
+        for (auto it = begin; it != end; ++it) {
+            addItem(*it);
+        }
+    }
+
+    template <typename InputIterator>
+    void addItems(InputIterator begin, InputIterator end, std::random_access_iterator_tag) {
+        const size_t n = end - begin;
+        // the largest symbol decides whether all of them fit into the array
+        size_t maxIndex(0);
+        for (size_t i = 0; i < n; ++i) {
+            maxIndex = std::max<size_t>(maxIndex, (UnsignedType)begin[i]);
+        }
+        // the array may take as many entries as there are items, so that it isn't much larger than they are
+        if (n == 0 || (maxIndex >= dense.size() && !grow(maxIndex, numItems + n)) ||
+            n < numLanes * minItemsPerEntry * (maxIndex + 1)) {
+            addItems(begin, end, std::input_iterator_tag());
+            return;
+        }
+
+        // only the first maxIndex + 1 entries can change
+        const size_t size = maxIndex + 1;
+        std::vector<uint32_t> lanes(numLanes * size, 0);
+        uint32_t *const lane0 = lanes.data(), *const lane1 = lane0 + size,
+                 *const lane2 = lane1 + size, *const lane3 = lane2 + size;
+        // flush the 32-bit lanes into dense before any of them can overflow
+        for (size_t chunkBegin = 0; chunkBegin < n; chunkBegin += maxItemsPerChunk) {
+            const size_t chunkEnd = std::min(n, chunkBegin + maxItemsPerChunk);
+            const size_t whole = chunkEnd - (chunkEnd - chunkBegin) % numLanes;
+            for (size_t i = chunkBegin; i < whole; i += numLanes) {
+                ++lane0[(UnsignedType)begin[i]];
+                ++lane1[(UnsignedType)begin[i + 1]];
+                ++lane2[(UnsignedType)begin[i + 2]];
+                ++lane3[(UnsignedType)begin[i + 3]];
+            }
+            for (size_t i = whole; i < chunkEnd; ++i) {
+                ++lane0[(UnsignedType)begin[i]];
+            }
+            for (size_t index = 0; index < size; ++index) {
+                const uint64_t count = (uint64_t)lane0[index] + lane1[index] + lane2[index] + lane3[index];
+                numSymbols += (dense[index] == 0 && count > 0);
+                dense[index] += count;
+            }
+            if (chunkEnd < n) std::fill(lanes.begin(), lanes.end(), 0);
+        }
+        numItems += n;
+    }
+
+    std::vector<uint64_t> dense;
+    std::unordered_map<SymbolType, uint64_t> sparse;
+    uint64_t numItems;
+    size_t numSymbols;
+};
+
+template <typename SymbolType>
+class Histogram<SymbolType, false> {
+public:
+    Histogram() : counts(), numItems(0) {}
+
+    void addItem(const SymbolType &symbol) {
+        ++counts[symbol];
+        ++numItems;
+    }
+
+    template <typename InputIterator>
+    void addItems(InputIterator begin, InputIterator end) {
+        for (auto it = begin; it != end; ++it) {
+            addItem(*it);
+        }
+    }
+
+    uint64_t count(const SymbolType &symbol) const {
+        const auto it = counts.find(symbol);
+        return it == counts.end() ? 0 : it->second;
+    }
+
+    template <typename Callback>
+    void forEach(const Callback &callback) const {
+        for (auto it = counts.cbegin(); it != counts.cend(); ++it) {
+            callback(it->first, it->second);
+        }
+    }
+
+    size_t getNumSymbols() const {
+        return counts.size();
+    }
+
+    /// There is no array, all symbols are counted in the hash map
+    size_t getDenseSize() const {
+        return 0;
+    }
+
+    static size_t denseIndex(const SymbolType &) {
+        return 0;
+    }
+
+    uint64_t getNumItems() const {
+        return numItems;
+    }
+
+    void clear() {
+        counts.clear();
+        numItems = 0;
+    }
+
+protected:
+    std::unordered_map<SymbolType, uint64_t> counts;
+    uint64_t numItems;
+};
+
+/// Numbers the symbols of a Histogram 0, 1, ... in the order of Histogram::forEach()
+/**
+ * The IDs of the symbols in the histogram's array are kept in an array indexed the
+ * same way, so only the other ones (see Histogram) are looked up in a hash map.
+ */
+template <typename SymbolType>
+class SymbolIds {
+public:
+    SymbolIds() : denseIds(), sparseIds(), symbols() {}
+
+    /// Number the symbols of a histogram
+    void assign(const Histogram<SymbolType> &histogram) {
+        clear();
+        denseIds.assign(histogram.getDenseSize(), -1);
+        symbols.reserve(histogram.getNumSymbols());
+        histogram.forEach([&](const SymbolType &symbol, const uint64_t) {
+            const size_t index = Histogram<SymbolType>::denseIndex(symbol);
+            if (index < denseIds.size()) {
+                denseIds[index] = (int)symbols.size();
+            } else {
+                sparseIds.emplace(symbol, (int)symbols.size());
+            }
+            symbols.push_back(symbol);
+        });
+    }
+
+    /// The ID of a symbol of the histogram
+    int operator[](const SymbolType &symbol) const {
+        const size_t index = Histogram<SymbolType>::denseIndex(symbol);
+        if (index < denseIds.size()) {
+            assert(denseIds[index] >= 0);
+            return denseIds[index];
+        }
+        assert(sparseIds.count(symbol) > 0);
+        return sparseIds.find(symbol)->second;
+    }
+
+    /// The symbol with an ID
+    const SymbolType &symbol(const int id) const {
+        return symbols[id];
+    }
+
+    /// The symbols, indexed by their IDs
+    const std::vector<SymbolType> &getSymbols() const {
+        return symbols;
+    }
+
+    size_t size() const {
+        return symbols.size();
+    }
+
+    bool empty() const {
+        return symbols.empty();
+    }
+
+    void clear() {
+        denseIds.clear();
+        sparseIds.clear();
+        symbols.clear();
+    }
+
+protected:
+    /// the IDs of the symbols in the histogram's array, by their index there (-1 if they didn't occur)
+    std::vector<int> denseIds;
+    std::unordered_map<SymbolType, int> sparseIds;
+    std::vector<SymbolType> symbols;
+};
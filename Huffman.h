@@ -1,141 +1,169 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <iterator>
 #include <iostream>
-#include <queue>
+#include <numeric>
 #include <sstream>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
+#include "BitReader.h"
 #include "BitWriter.h"
-
-/// A node in a Huffman tree (base class)
-struct HuffNode {
-    const int frequency;
-    virtual ~HuffNode() {}
-protected:
-    HuffNode(const int frequency) : frequency(frequency) {}
-};
-
-/// A leaf in a Huffman tree
-struct HuffLeaf : public HuffNode {
-    const int symbolId;
-    /// Construct a Huffman leaf from symbol ID and frequency
-    HuffLeaf(const int symbolId, const int frequency) : HuffNode(frequency), symbolId(symbolId) {}
-};
-
-/// An inner node in a Huffman tree
-struct HuffInnerNode : public HuffNode {
-    const int leftId, rightId;
-    /// Construct a Huffman inner node
-    /// \param leftId ID of the left child node
-    /// \param rightId ID of the right child node
-    /// \param combinedFrequency frequency of the combined symbol (sum of left and right child's frequency)
-    HuffInnerNode(const int leftId, const int rightId, const int combinedFrequency) :
-        HuffNode(combinedFrequency),
-        leftId(leftId),
-        rightId(rightId) {}
+#include "Common.h"
+#include "Histogram.h"
+
+/// A Huffman code packed into an integer, for writing it to a BitBuffer or BitWriter in one go
+struct HuffCodeWord {
+    HuffCodeWord() : bits(0), length(0) {}
+    /// the code in the lowest `length` bits, first bit most significant
+    uint64_t bits;
+    unsigned int length;
 };
 
 /// Generic Huffman Code Builder. Only constructs code, does not en-/decode.
+/**
+ * The codes are canonical (codes of the same length are consecutive numbers,
+ * assigned in the order of the symbols) and at most maxCodeLength bits long.
+ * Thus, a code table only consists of the number of codes of each length and
+ * the symbols in code order, see writeTable() and HuffmanReader.
+ */
 template <typename SymbolType>
 class HuffmanBuilder {
 public:
     typedef std::vector<bool> HuffCode;
-    HuffmanBuilder() : numItems(0), symbols(), frequencies(), codes(), nodes() {}
+    /// The maximum length of a code in bits
+    static const unsigned int maxCodeLength = 32;
+
+    HuffmanBuilder() : histogram(), symbols(), frequencies(), codeWords(), canonicalOrder() {}
 
     /// add an occurence to the frequency statistics
     void addItem(const SymbolType &symbol) {
-        auto pos = symbols.find(symbol);
-        if (pos == symbols.end()) {
-            pos = symbols.insert(typename std::unordered_map<SymbolType, int>::value_type(symbol, (int)symbols.size())).first;
-            frequencies.push_back(0);
-        }
-        frequencies[pos->second]++;
-        ++numItems;
+        histogram.addItem(symbol);
     }
 
     /// add a sequence of occurences to the frequency statistics
     template <class InputIterator>
     void addItems(InputIterator begin, InputIterator end) {
-        for (auto it = begin; it != end; ++it) {
-            addItem(*it);
-        }
+        histogram.addItems(begin, end);
     }
 
     /// Construct a Huffman code for the symols encountered, and the frequencies with which they were encountered
     void construct() {
-        codes.resize(frequencies.size());
-        constructTree();
-        computeCodes(nodes.size() - 1, HuffCode());
-
-        // Delete the nodes, we don't need them any more
-        for (uint i = 0; i < nodes.size(); ++i) {
-            assert(nodes[i] != NULL);
-            delete nodes[i];
+        // number the symbols
+        symbols.assign(histogram);
+        frequencies.clear();
+        frequencies.reserve(symbols.size());
+        histogram.forEach([this](const SymbolType &, const uint64_t count) {
+            frequencies.push_back(count);
+        });
+
+        codeWords.assign(frequencies.size(), HuffCodeWord());
+        // a single symbol gets the empty code
+        if (frequencies.size() > 1) {
+            computeCodeLengths();
+            limitCodeLengths();
         }
-        nodes.clear();
+        assignCanonicalCodes();
     }
 
     /// Get the number of different symbols encountered
     int getNumSymbols() const {
-        return symbols.size();
+        return histogram.getNumSymbols();
     }
 
     /// Get the total number of occurences encountered
-    int getNumItems() const {
-        return numItems;
+    uint64_t getNumItems() const {
+        return histogram.getNumItems();
+    }
+
+    /// The frequencies of the symbols, see getHistogram()
+    const Histogram<SymbolType> &getHistogram() const {
+        return histogram;
     }
 
     /// Get the code for a symbol. Must to have called construct() before.
-    HuffCode getCode(const SymbolType &symbol) {
-        assert(symbols[symbol] < (SymbolType) codes.size());
-        return codes[symbols[symbol]];
+    HuffCode getCode(const SymbolType &symbol) const {
+        const HuffCodeWord &code = codeWords[symbols[symbol]];
+        HuffCode result(code.length);
+        for (uint i = 0; i < code.length; ++i) {
+            result[i] = (code.bits >> (code.length - i - 1)) & 0x1;
+        }
+        return result;
+    }
+
+    /// Call a function with each symbol and its code packed into a HuffCodeWord.
+    /// Need to have called construct() before.
+    template <typename Callback>
+    void forEachCodeWord(const Callback &callback) const {
+        for (uint symbolId = 0; symbolId < symbols.size(); ++symbolId) {
+            callback(symbols.symbol(symbolId), codeWords[symbolId]);
+        }
     }
 
     /// Get the length of a symbol's code. Need to have called construct() before.
     int getCodeLength(const SymbolType &symbol) const {
-        assert(symbols[symbol] < codes.size());
-        return codes[symbols[symbol]].size();
+        return codeWords[symbols[symbol]].length;
+    }
+
+    /// Get the length of the longest code. Need to have called construct() before.
+    unsigned int getMaxCodeLength() const {
+        unsigned int maxLength(0);
+        for (const HuffCodeWord &code : codeWords) {
+            maxLength = std::max(maxLength, code.length);
+        }
+        return maxLength;
     }
 
     /// Get the number of bits needed to encode the occurrences encountered with the
     /// code that was calculated (need to have called construct() before).
     /// \return size in bits for coding the items and the *structure* of the huffman table
     long long getBitsNeeded() const {
+        if (symbols.empty()) return 0;
         long long bits(0);
-        assert(frequencies.size() == codes.size());
+        assert(frequencies.size() == codeWords.size());
         for (uint i = 0; i < frequencies.size(); ++i) {
-            bits += frequencies[i] * codes[i].size();
+            bits += frequencies[i] * codeWords[i].length;
         }
-        // For each inner node, store whether left and right children are inner nodes or leaves
-        // As we're dealing with a binary tree, this suffices.
-        bits += (symbols.size() - 1) * 2;
-        //bits += getBitsForTree();
+        // The code is canonical, so the structure is given by the number of codes of each length
+        bits += 6 + getMaxCodeLength() * bitsFor(symbols.size() + 1);
         return bits;
     }
 
-    /// Get the number of bits to encode the *structure* of the huffman table/tree
-    /// Codes only code lengths (in unary)
-    long long getBitsForTree() const {
-        long long bits(0);
-        size_t maxLen(0);
-        for (uint i = 0; i < codes.size(); ++i) {
-            maxLen = (codes[i].size() > maxLen) ? codes[i].size() : maxLen;
+    /// Get the number of bits that writeTable() needs for the number of symbols and the symbols
+    /// themselves (the rest of the table is included in getBitsNeeded())
+    /// \param symbolBits the number of bits per symbol, as passed to writeTable()
+    long long getBitsForTableLabels(const int symbolBits) const {
+        return 32 + static_cast<long long>(getNumSymbols()) * symbolBits;
+    }
+
+    /// Write the code table for HuffmanReader: the number of symbols (32 bits), the length of the
+    /// longest code (6 bits), the number of codes of each length, and the symbols in code order as
+    /// fixed-length integers. Need to have called construct() before.
+    /// \param writer the BitWriter to write to
+    /// \param symbolBits the number of bits to write per symbol
+    void writeTable(BitWriter &writer, const int symbolBits) const {
+        typedef typename std::make_unsigned<SymbolType>::type UnsignedType;
+        writer.writeBits(symbols.size(), 32);
+        if (symbols.empty()) return;
+
+        const unsigned int maxLength(getMaxCodeLength());
+        std::vector<uint64_t> lengthCounts(maxLength + 1, 0);
+        for (const HuffCodeWord &code : codeWords) {
+            lengthCounts[code.length]++;
         }
-        bits += 2*log_2(maxLen) + 1; // code maxLen using gamma coding
-        for (uint i = 0; i < codes.size(); ++i) {
-            auto number = maxLen - codes[i].size();
-            bits += number + 1; // code in unary
+        writer.writeBits(maxLength, 6);
+        const int countBits = bitsFor(symbols.size() + 1);
+        for (unsigned int length = 1; length <= maxLength; ++length) {
+            writer.writeBits(lengthCounts[length], countBits);
         }
-        return bits;
-    }
 
-    /// Get the number of bits that are required to store the labels to the table entries,
-    /// as fixed-length codes.
-    long long getBitsForTableLabels() const {
-        return static_cast<long long>(getNumSymbols()) * log_2(getNumSymbols());
+        for (const int symbolId : canonicalOrder) {
+            writer.writeBits((UnsignedType)symbols.symbol(symbolId), symbolBits);
+        }
     }
 
     /// Get a string representation, including the symbols, their codes and absolute as well as
@@ -143,12 +171,13 @@ public:
     std::string toString() const {
         std::stringstream os;
         os << "Huffman with " << frequencies.size() << " symbols:" << std::endl;
-        for (auto it = symbols.cbegin(); it != symbols.cend(); ++it) {
-            os << +it->first << ": ";
-            std::copy(codes[it->second].cbegin(), codes[it->second].cend(), std::ostream_iterator<bool>(os));
-            os << " (" << codes[it->second].size() << "b)"
-               << " frequency " << frequencies[it->second]
-               << " (" << (frequencies[it->second] * 100.0) / numItems  << "%)"
+        for (uint symbolId = 0; symbolId < symbols.size(); ++symbolId) {
+            const HuffCode code(getCode(symbols.symbol(symbolId)));
+            os << +symbols.symbol(symbolId) << ": ";
+            std::copy(code.cbegin(), code.cend(), std::ostream_iterator<bool>(os));
+            os << " (" << code.size() << "b)"
+               << " frequency " << frequencies[symbolId]
+               << " (" << (frequencies[symbolId] * 100.0) / getNumItems()  << "%)"
                << std::endl;
         }
         return os.str();
@@ -160,46 +189,188 @@ public:
     }
 
 protected:
-    /// Construct a Huffman tree from the symbols encountered and the frequencies observed.
-    void constructTree() {
-        // PQ with operator >. This has the effect of constructing codes that are maximum-variance, but we don't really care.
-        std::priority_queue<std::pair<int,int>, std::vector<std::pair<int,int>>, std::greater<std::pair<int,int>>> queue;
-        // Fill the queue with all the nodes
-        for (uint i = 0; i < frequencies.size(); ++i) {
-            assert(frequencies[i] > 0);
-            nodes.push_back(new HuffLeaf(i, frequencies[i]));
-            queue.push(std::make_pair(frequencies[i], i));
+    /// Compute the lengths of the Huffman codes for the frequencies observed, without building
+    /// the Huffman tree. This is the in-place algorithm of Moffat and Katajainen ("In-place
+    /// calculation of minimum-redundancy codes", WADS 1995): after sorting the symbols by
+    /// frequency, the leaves and the inner nodes created so far form two queues of increasing
+    /// weight, so merging them takes linear time.
+    void computeCodeLengths() {
+        const int n = frequencies.size();
+        assert(n > 1);
+        std::vector<int> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [this](const int a, const int b) {
+            return frequencies[a] < frequencies[b];
+        });
+        std::vector<int64_t> a(n);
+        for (int i = 0; i < n; ++i) {
+            assert(frequencies[order[i]] > 0);
+            a[i] = frequencies[order[i]];
+        }
+
+        // First pass, left to right: combine the two lightest nodes into inner node `next`, whose
+        // weight replaces a[next]. Combined inner nodes are overwritten by their parent's index.
+        a[0] += a[1];
+        int root(0), leaf(2);
+        for (int next = 1; next < n - 1; ++next) {
+            if (leaf >= n || a[root] < a[leaf]) {
+                a[next] = a[root];
+                a[root++] = next;
+            } else {
+                a[next] = a[leaf++];
+            }
+            if (leaf >= n || (root < next && a[root] < a[leaf])) {
+                a[next] += a[root];
+                a[root++] = next;
+            } else {
+                a[next] += a[leaf++];
+            }
         }
 
-        // Process the nodes from the PQ and combine symbols until only one is left
-        while (queue.size() > 1) {
-            auto right = queue.top(); queue.pop();
-            auto left = queue.top(); queue.pop();
-            const int frequency(right.first + left.first);
-            nodes.push_back(new HuffInnerNode(right.second, left.second, frequency));
-            queue.push(std::make_pair(frequency, nodes.size() - 1));
+        // Second pass, right to left: turn the parent indices into inner node depths
+        a[n - 2] = 0;
+        for (int next = n - 3; next >= 0; --next) {
+            a[next] = a[a[next]] + 1;
         }
+
+        // Third pass, right to left: compute the leaf depths from the numbers of inner nodes per depth
+        int available(1), used(0), depth(0), next(n - 1);
+        root = n - 2;
+        while (available > 0) {
+            while (root >= 0 && a[root] == depth) {
+                ++used;
+                --root;
+            }
+            while (available > used) {
+                a[next--] = depth;
+                --available;
+            }
+            available = 2 * used;
+            ++depth;
+            used = 0;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            codeWords[order[i]].length = a[i];
+        }
+    }
+
+    /// Shorten codes that are longer than maxCodeLength. Their symbols get the longest
+    /// allowed length, and other codes are made longer until the code is a prefix code
+    /// again (the Kraft inequality holds), keeping the longest codes for the least
+    /// frequent symbols.
+    void limitCodeLengths() {
+        if (getMaxCodeLength() <= maxCodeLength) return;
+
+        // symbols from the shortest to the longest code
+        std::vector<int> order(codeWords.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [this](const int a, const int b) {
+            return codeWords[a].length < codeWords[b].length;
+        });
+
+        std::vector<uint64_t> lengthCounts(maxCodeLength + 1, 0);
+        for (const HuffCodeWord &code : codeWords) {
+            lengthCounts[code.length < maxCodeLength ? code.length : maxCodeLength]++;
+        }
+        // Kraft sum in units of 2^-maxCodeLength
+        const uint64_t one = 1ull << maxCodeLength;
+        uint64_t kraft(0);
+        for (unsigned int length = 1; length <= maxCodeLength; ++length) {
+            kraft += lengthCounts[length] << (maxCodeLength - length);
+        }
+        while (kraft > one) {
+            // make one of the longest codes that can still grow one bit longer
+            unsigned int length = maxCodeLength - 1;
+            while (lengthCounts[length] == 0) {
+                --length;
+            }
+            assert(length > 0);
+            lengthCounts[length]--;
+            lengthCounts[length + 1]++;
+            kraft -= 1ull << (maxCodeLength - length - 1);
+        }
+
+        unsigned int length(1);
+        for (const int symbolId : order) {
+            while (lengthCounts[length] == 0) {
+                ++length;
+            }
+            codeWords[symbolId].length = length;
+            lengthCounts[length]--;
+        }
+    }
+
+    /// Assign canonical codes according to the code lengths: sort the symbols by code length
+    /// and value, and give consecutive codes to the symbols of each length
+    void assignCanonicalCodes() {
+        const std::vector<SymbolType> &symbolValues(symbols.getSymbols());
+        canonicalOrder.resize(codeWords.size());
+        std::iota(canonicalOrder.begin(), canonicalOrder.end(), 0);
+        std::sort(canonicalOrder.begin(), canonicalOrder.end(), [&](const int a, const int b) {
+            return codeWords[a].length < codeWords[b].length ||
+                (codeWords[a].length == codeWords[b].length && symbolValues[a] < symbolValues[b]);
+        });
+
+        uint64_t code(0);
+        unsigned int length(0);
+        for (const int symbolId : canonicalOrder) {
+            code <<= (codeWords[symbolId].length - length);
+            length = codeWords[symbolId].length;
+            codeWords[symbolId].bits = code++;
+        }
+    }
+
+    Histogram<SymbolType> histogram;
+    /// the symbols' IDs and frequencies, see construct()
+    SymbolIds<SymbolType> symbols;
+    std::vector<uint64_t> frequencies;
+    std::vector<HuffCodeWord> codeWords;
+    /// symbol IDs in the order of their codes
+    std::vector<int> canonicalOrder;
+};
+
+/// Symbol to code word lookup table for the Huffman writers. The symbols that the Huffman
+/// code's Histogram counts in its array are looked up in an array indexed the same way, only
+/// the others are hashed.
+template <typename SymbolType>
+class HuffmanCodeTable {
+public:
+    HuffmanCodeTable() : dense(), sparse(), built(false) {}
+
+    /// Fill the table from a constructed Huffman code
+    void build(const HuffmanBuilder<SymbolType> &huffman) {
+        dense.assign(huffman.getHistogram().getDenseSize(), HuffCodeWord());
+        sparse.clear();
+        huffman.forEachCodeWord([this](const SymbolType &symbol, const HuffCodeWord &code) {
+            const size_t index = Histogram<SymbolType>::denseIndex(symbol);
+            if (index < dense.size()) {
+                dense[index] = code;
+            } else {
+                sparse[symbol] = code;
+            }
+        });
+        built = true;
     }
 
-    /// Recursively assign codes to the symbols
-    void computeCodes(const int nodeId, HuffCode prefix) {
-        const HuffNode *node(nodes[nodeId]);
-        if (const HuffLeaf *leaf = dynamic_cast<const HuffLeaf*>(node)) {
-            codes[leaf->symbolId] = std::move(prefix);
-        } else if (const HuffInnerNode *innerNode = dynamic_cast<const HuffInnerNode*>(node)) {
-            prefix.push_back(false);
-            computeCodes(innerNode->leftId, prefix);
+    bool empty() const {
+        return !built;
+    }
 
-            prefix.back() = true;
-            computeCodes(innerNode->rightId, prefix);
+    /// The code of a symbol that was encountered (the only symbol has the empty code)
+    const HuffCodeWord &operator[](const SymbolType &symbol) const {
+        const size_t index = Histogram<SymbolType>::denseIndex(symbol);
+        if (likely(index < dense.size())) {
+            return dense[index];
         }
+        assert(sparse.count(symbol) > 0);
+        return sparse.find(symbol)->second;
     }
 
-    int numItems;
-    std::unordered_map<SymbolType, int> symbols;
-    std::vector<int> frequencies;
-    std::vector<HuffCode> codes;
-    std::vector<HuffNode*> nodes;
+protected:
+    std::vector<HuffCodeWord> dense;
+    std::unordered_map<SymbolType, HuffCodeWord> sparse;
+    bool built;
 };
 
 /// Constructs a blocked Huffman coding
@@ -224,17 +395,40 @@ struct HuffmanBlocker {
         }
     }
 
-    /// add a sequence of occurences to the frequency statistics
+    /// add a sequence of occurences to the frequency statistics. The blocks are
+    /// collected first and counted in bulk.
     template <class InputIterator>
     void addItems(InputIterator begin, InputIterator end) {
-        for (auto it = begin; it != end; ++it) {
+        // complete a partially filled block first
+        auto it = begin;
+        for (; it != end && !tempStore.empty(); ++it) {
             addItem(*it);
         }
+
+        std::vector<OutputType> blocks;
+        OutputType block{};
+        uint blockSize(0);
+        for (; it != end; ++it) {
+            block |= ((OutputType)*it << (blockSize * inputSize));
+            if (++blockSize == blockingFactor) {
+                blocks.push_back(block);
+                block = OutputType{};
+                blockSize = 0;
+            }
+        }
+        huffman.addItems(blocks.cbegin(), blocks.cend());
+
+        // keep the items of the last, incomplete block for flushQueue()
+        const uint64_t mask = (inputSize >= 64) ? ~0ull : ((1ull << inputSize) - 1);
+        for (uint i = 0; i < blockSize; ++i) {
+            tempStore.push_back((InputType)((block >> (i * inputSize)) & mask));
+        }
     }
 
     /// Flush all remaining unwritten symbols. Call this after adding all items.
     void flushQueue() {
         const bool verbose = false;
+        if (tempStore.empty()) return;
 
         if (verbose && tempStore.size() < blockingFactor)
             std::cout << "Filling up: have " << tempStore.size() << " need " << blockingFactor << std::endl;
@@ -259,42 +453,52 @@ struct HuffmanBlocker {
     HuffmanBuilder<OutputType> huffman;
 };
 
-/// Unfinished Huffman code writer
+/// Huffman code writer. Buffers the codes until writeBuffer() is called.
+/// The Huffman code must be constructed before the first item is added.
 template <typename SymbolType>
 class HuffmanWriter {
 public:
-    HuffmanWriter(HuffmanBuilder<SymbolType> &huffman, BitWriter &writer): huffman(huffman), writer(writer) {}
+    HuffmanWriter(HuffmanBuilder<SymbolType> &huffman, BitWriter &writer): huffman(huffman), writer(writer), table(), buffer() {}
 
     void write(const SymbolType &sym) {
-        std::cout << "HW: Writing " << (int) sym << std::endl;
-        writer.writeBits(huffman.getCode(sym));
+        const HuffCodeWord &code = getCodeWord(sym);
+        writer.writeBits(code.bits, code.length);
     }
 
     void addItem(const SymbolType &sym) {
-        const std::vector<bool> &vec(huffman.getCode(sym));
-        buffer.insert(buffer.end(), vec.begin(), vec.end());
+        const HuffCodeWord &code = getCodeWord(sym);
+        buffer.writeBits(code.bits, code.length);
     }
 
     template <typename InputIterator>
     void addItems(InputIterator begin, InputIterator end) {
-        for (InputIterator it = begin; it != end; ++it) {
-            addItem(*it);
+        if (table.empty()) {
+            table.build(huffman);
         }
+        buffer.writeCodes(begin, end, table);
     }
 
     void writeBuffer() {
-        std::cout << "HuffmanWriter: writing buffer of " << buffer.size() << " bits" << std::endl;
         writer.writeBits(buffer);
         buffer.clear();
     }
 
 protected:
+    const HuffCodeWord &getCodeWord(const SymbolType &sym) {
+        if (table.empty()) {
+            table.build(huffman);
+        }
+        return table[sym];
+    }
+
     HuffmanBuilder<SymbolType> &huffman;
     BitWriter &writer;
-    std::vector<bool> buffer;
+    HuffmanCodeTable<SymbolType> table;
+    BitBuffer buffer;
 };
 
-/// Unfinished writer for blocked Huffman codes
+/// Writer for blocked Huffman codes, see HuffmanBlocker. Buffers the codes until writeBuffer() is called.
+/// The Huffman code must be constructed before the first item is added.
 template <typename InputType, typename OutputType, int inputSize = sizeof(InputType)*8, int outputSize = sizeof(OutputType)*8>
 class BlockedHuffmanWriter {
 public:
@@ -302,15 +506,18 @@ public:
         : huffman(huffman)
         , writer(writer)
         , blockingFactor(outputSize / inputSize)
-        , tempStore() {
+        , table()
+        , block()
+        , blockSize(0)
+        , buffer() {
         assert(outputSize % inputSize == 0);
-        tempStore.reserve(blockingFactor);
     }
 
     void addItem(const InputType &symbol) {
-        tempStore.push_back(symbol);
-        if (tempStore.size() == blockingFactor) {
-            flushTempStore();
+        // same layout as in HuffmanBlocker::flushQueue()
+        block |= ((OutputType)symbol << (blockSize * inputSize));
+        if (++blockSize == blockingFactor) {
+            flushBlock();
         }
     }
 
@@ -322,28 +529,258 @@ public:
     }
 
     void writeBuffer() {
-        flushTempStore();
-        std::cout << "BlockedHuffmanWriter: writing    " << buffer.size() << " bits" << std::endl;
+        // the last block is filled up with zeroes, like HuffmanBlocker does
+        if (blockSize > 0) {
+            flushBlock();
+        }
         writer.writeBits(buffer);
         buffer.clear();
     }
 
 
 protected:
-    void flushTempStore() {
-        // move into huffman
-        OutputType result{};
-        for (uint i = 0; i < blockingFactor; ++i) {
-            result |= (tempStore[i] << (i * inputSize));
+    void flushBlock() {
+        if (table.empty()) {
+            table.build(huffman);
         }
-        const std::vector<bool> &vec(huffman.getCode(result));
-        buffer.insert(buffer.end(), vec.begin(), vec.end());
-        tempStore.clear();
+        const HuffCodeWord &code = table[block];
+        buffer.writeBits(code.bits, code.length);
+        block = OutputType{};
+        blockSize = 0;
     }
 
     HuffmanBuilder<OutputType> &huffman;
     BitWriter &writer;
     const uint blockingFactor;
-    std::vector<InputType> tempStore;
-    std::vector<bool> buffer;
+    HuffmanCodeTable<OutputType> table;
+    OutputType block;
+    uint blockSize;
+    BitBuffer buffer;
+};
+
+/// Decoder for canonical Huffman codes whose table was written with HuffmanBuilder::writeTable()
+/**
+ * Decoding is table-driven: the next lookupBits bits of the input index a
+ * table that yields the up to maxSymbolsPerLookup symbols whose codes are
+ * contained in these bits, and the number of bits they take. Only codes that
+ * are longer than lookupBits are decoded canonically, one length after the other.
+ */
+template <typename SymbolType>
+class HuffmanReader {
+    /// the maximum number of bits to index the lookup table with
+    static const unsigned int maxLookupBits = 11;
+    /// the maximum number of symbols decoded in one lookup
+    static const unsigned int maxSymbolsPerLookup = 3;
+
+    struct LookupEntry {
+        SymbolType symbols[maxSymbolsPerLookup];
+        /// the number of symbols whose codes are complete in the lookup bits (0 if the first one isn't)
+        uint8_t count;
+        /// the number of bits taken by these symbols' codes
+        uint8_t bits;
+        /// the number of bits taken by the first symbol's code
+        uint8_t firstBits;
+    };
+
+public:
+    HuffmanReader() : symbols(), maxLength(0), lengthCounts(), firstCodes(), firstIndices(),
+                      lookupBits(0), lookup(), error(false) {}
+
+    /// Read a code table
+    /// \param reader the BitReader to read from
+    /// \param symbolBits the number of bits per symbol, as passed to HuffmanBuilder::writeTable()
+    /// \return whether the table was well-formed
+    bool readTable(BitReader &reader, const int symbolBits) {
+        symbols.clear();
+        lookup.clear();
+        lookupBits = 0;
+        error = false;
+        const uint64_t numSymbols = reader.readBits(32);
+        if (numSymbols == 0) return !reader.overrun();
+
+        maxLength = reader.readBits(6);
+        if (maxLength > HuffmanBuilder<SymbolType>::maxCodeLength) return false;
+        const int countBits = bitsFor(numSymbols + 1);
+        lengthCounts.assign(maxLength + 1, 0);
+        uint64_t total(0), kraft(0);
+        for (unsigned int length = 1; length <= maxLength; ++length) {
+            lengthCounts[length] = reader.readBits(countBits);
+            total += lengthCounts[length];
+            kraft += lengthCounts[length] << (maxLength - length);
+        }
+        // there must be one code per symbol, and it must be a prefix code
+        if (maxLength == 0 ? (numSymbols != 1) : (total != numSymbols || kraft > (1ull << maxLength))) {
+            return false;
+        }
+
+        for (uint64_t i = 0; i < numSymbols && !reader.overrun(); ++i) {
+            symbols.push_back((SymbolType)reader.readBits(symbolBits));
+        }
+        if (reader.overrun()) return false;
+
+        // first code and index of the first symbol for each length
+        firstCodes.assign(maxLength + 1, 0);
+        firstIndices.assign(maxLength + 1, 0);
+        uint64_t code(0), index(0);
+        for (unsigned int length = 1; length <= maxLength; ++length) {
+            code = (code + lengthCounts[length - 1]) << 1;
+            firstCodes[length] = code;
+            firstIndices[length] = index;
+            index += lengthCounts[length];
+        }
+        buildLookup();
+        return true;
+    }
+
+    /// Decode one symbol
+    SymbolType decode(BitReader &reader) {
+        assert(!symbols.empty());
+        if (lookupBits == 0) {
+            // a single symbol with the empty code
+            return symbols[0];
+        }
+        const LookupEntry &entry = lookup[reader.peekBits(lookupBits)];
+        if (likely(entry.count > 0)) {
+            reader.consume(entry.firstBits);
+            return entry.symbols[0];
+        }
+        return decodeCanonical(reader);
+    }
+
+    /// Decode `count` symbols and append them to `items`
+    template <typename ItemType>
+    void decode(BitReader &reader, size_t count, std::vector<ItemType> &items) {
+        assert(count == 0 || !symbols.empty());
+        if (lookupBits == 0) {
+            items.insert(items.end(), count, symbols.empty() ? SymbolType{} : symbols[0]);
+            return;
+        }
+        // copy all of an entry's symbol slots unconditionally and advance by the valid ones
+        const size_t begin = items.size();
+        items.resize(begin + count + maxSymbolsPerLookup);
+        ItemType *out = items.data() + begin;
+        ItemType *const end = out + count;
+        while (out + maxSymbolsPerLookup <= end) {
+            const LookupEntry &entry = lookup[reader.peekBits(lookupBits)];
+            if (likely(entry.count > 0)) {
+                for (uint i = 0; i < maxSymbolsPerLookup; ++i) {
+                    out[i] = entry.symbols[i];
+                }
+                out += entry.count;
+                reader.consume(entry.bits);
+            } else {
+                *out++ = decodeCanonical(reader);
+            }
+        }
+        while (out < end) {
+            *out++ = decode(reader);
+        }
+        items.resize(begin + count);
+    }
+
+    /// Get the number of different symbols in the code
+    int getNumSymbols() const {
+        return symbols.size();
+    }
+
+    /// Whether an invalid code was encountered while decoding
+    bool hadError() const {
+        return error;
+    }
+
+protected:
+    /// Decode a symbol by trying one code length after the other
+    SymbolType decodeCanonical(BitReader &reader) {
+        for (unsigned int length = 1; length <= maxLength; ++length) {
+            const uint64_t offset = reader.peekBits(length) - firstCodes[length];
+            if (offset < lengthCounts[length]) {
+                reader.consume(length);
+                return symbols[firstIndices[length] + offset];
+            }
+        }
+        // the code can be incomplete, so not every bit sequence is a code
+        error = true;
+        reader.consume(maxLength);
+        return symbols[0];
+    }
+
+    /// Build the lookup table from the canonical code
+    void buildLookup() {
+        lookupBits = (maxLength < maxLookupBits) ? maxLength : maxLookupBits;
+        if (lookupBits == 0) return;
+        const size_t size = 1ul << lookupBits;
+
+        // symbol index and code length of the first code in each bit sequence (-1 if it's longer than lookupBits)
+        std::vector<std::pair<int, unsigned int>> first(size, std::make_pair(-1, 0u));
+        for (unsigned int length = 1; length <= lookupBits; ++length) {
+            for (uint64_t i = 0; i < lengthCounts[length]; ++i) {
+                const uint64_t code = firstCodes[length] + i;
+                const size_t begin = code << (lookupBits - length), end = (code + 1) << (lookupBits - length);
+                std::fill(first.begin() + begin, first.begin() + end,
+                          std::make_pair((int)(firstIndices[length] + i), length));
+            }
+        }
+
+        lookup.assign(size, LookupEntry());
+        for (size_t bits = 0; bits < size; ++bits) {
+            LookupEntry &entry = lookup[bits];
+            entry.count = 0;
+            entry.firstBits = first[bits].second;
+            unsigned int used(0);
+            while (entry.count < maxSymbolsPerLookup) {
+                // the bits following the ones used are unknown and zero here, so the code must end before
+                const auto &next = first[(bits << used) & (size - 1)];
+                if (next.first < 0 || used + next.second > lookupBits) break;
+                entry.symbols[entry.count++] = symbols[next.first];
+                used += next.second;
+            }
+            entry.bits = used;
+        }
+    }
+
+    /// symbols in code order
+    std::vector<SymbolType> symbols;
+    unsigned int maxLength;
+    std::vector<uint64_t> lengthCounts, firstCodes, firstIndices;
+    unsigned int lookupBits;
+    std::vector<LookupEntry> lookup;
+    bool error;
+};
+
+/// Decoder for blocked Huffman codes written by BlockedHuffmanWriter
+template <typename InputType, typename OutputType, int inputSize = sizeof(InputType)*8, int outputSize = sizeof(OutputType)*8>
+class BlockedHuffmanReader {
+public:
+    BlockedHuffmanReader() : blockingFactor(outputSize / inputSize), huffman() {
+        assert(outputSize % inputSize == 0);
+    }
+
+    /// Read the code table, see HuffmanReader::readTable()
+    bool readTable(BitReader &reader) {
+        return huffman.readTable(reader, outputSize);
+    }
+
+    /// Decode `count` items and append them to `items`
+    void decode(BitReader &reader, const size_t count, std::vector<InputType> &items) {
+        const uint64_t mask = (inputSize >= 64) ? ~0ull : ((1ull << inputSize) - 1);
+        std::vector<OutputType> blocks;
+        blocks.reserve((count + blockingFactor - 1) / blockingFactor);
+        huffman.decode(reader, (count + blockingFactor - 1) / blockingFactor, blocks);
+
+        size_t decoded(0);
+        for (const OutputType block : blocks) {
+            for (uint i = 0; i < blockingFactor && decoded < count; ++i, ++decoded) {
+                items.push_back((InputType)((block >> (i * inputSize)) & mask));
+            }
+        }
+    }
+
+    /// Whether an invalid code was encountered while decoding
+    bool hadError() const {
+        return huffman.hadError();
+    }
+
+protected:
+    const uint blockingFactor;
+    HuffmanReader<OutputType> huffman;
 };
@@ -0,0 +1,341 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <ostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "BitWriter.h"
+#include "Common.h"
+#include "FileWriter.h"
+#include "FrontCoding.h"
+#include "Nodes.h"
+#include "TopDag.h"
+
+/// Identifies navigable Top DAG files ("TDGN")
+static const uint32_t MAPPED_TOPDAG_MAGIC = 0x5444474e;
+/// Version of the navigable Top DAG file format
+static const uint32_t MAPPED_TOPDAG_VERSION = 2;
+/// Size of the header of a navigable Top DAG file in bytes
+static const size_t MAPPED_TOPDAG_HEADER_SIZE = 32;
+/// Number of bits per merge type in a navigable Top DAG file
+static const unsigned int MAPPED_TOPDAG_MERGE_BITS = 3;
+
+/// Read-only view of fixed-width unsigned integers packed into little-endian bytes
+/**
+ * Entry i occupies bits i*width to (i+1)*width-1, where bit j is bit j%8 of byte j/8.
+ * An entry is extracted with a single (unaligned) 64-bit load, so the width must
+ * be at most 57 bits, and the array must be followed by 8 bytes of padding.
+ */
+struct PackedArray {
+    PackedArray() : data(NULL), width(0), mask(0) {}
+    PackedArray(const unsigned char *data, const unsigned int width)
+        : data(data), width(width), mask((1ull << width) - 1) {}
+
+    uint64_t operator[](const size_t index) const {
+        const size_t bit = index * width;
+        uint64_t word;
+        memcpy(&word, data + bit / 8, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        return (word >> (bit % 8)) & mask;
+    }
+
+    /// The number of bytes of an array with `count` entries of `width` bits, including the padding
+    static size_t bytesFor(const size_t count, const unsigned int width) {
+        return 8 * ((count * width + 63) / 64 + 1);
+    }
+
+    /// Pack values into 64-bit words (the padding included) for writing
+    static std::vector<uint64_t> pack(const std::vector<uint64_t> &values, const unsigned int width) {
+        std::vector<uint64_t> words(bytesFor(values.size(), width) / 8, 0);
+        for (size_t i = 0; i < values.size(); ++i) {
+            const size_t bit = i * width, offset = bit % 64;
+            words[bit / 64] |= values[i] << offset;
+            if (offset + width > 64) {
+                words[bit / 64 + 1] |= values[i] >> (64 - offset);
+            }
+        }
+        return words;
+    }
+
+    const unsigned char *data;
+    unsigned int width;
+    uint64_t mask;
+};
+
+/// Write a Top DAG in a form that can be navigated without decoding it, see MappedTopDag
+/**
+ * The file starts with a header of little-endian fields: magic number (32 bits),
+ * format version (32 bits), number of nodes in the represented tree (64 bits),
+ * number of leaves and of inner nodes in the DAG, and the widths of child pointers
+ * and label IDs in bits (32 bits each). It is followed by three PackedArray
+ * sections and the labels:
+ *  - the left and right child of each inner node, in the order of the node IDs
+ *  - the merge type of each inner node, MAPPED_TOPDAG_MERGE_BITS bits each
+ *  - the label ID of each leaf, its index in the label dictionary
+ *  - the number of bytes of the labels (little-endian, 32 bits) and the leaves'
+ *    labels in sorted order, front-coded by FrontCodingWriter
+ *
+ * Node IDs are the same as in the Top DAG, so leaf i (1 <= i <= number of leaves)
+ * is label ID entry i-1, and inner node i is child entries 2j and 2j+1 and merge
+ * type entry j for j = i - number of leaves - 1.
+ */
+class MappedTopDagWriter {
+public:
+    /// Write a Top DAG
+    /// \param dag the Top DAG to write, whose leaves must come first
+    /// \param fn output filename
+    /// \return the size of the file in bits, or -1 if it could not be written
+    static long long write(const TopDag<std::string> &dag, const std::string &fn) {
+        int numLeaves(0);
+        while (numLeaves + 1 < (int)dag.nodes.size() && dag.nodes[numLeaves + 1].left < 0) {
+            ++numLeaves;
+        }
+        const int numInnerNodes = (int)dag.nodes.size() - 1 - numLeaves;
+        const unsigned int pointerWidth = bitsFor(dag.nodes.size());
+        const unsigned int labelWidth = bitsFor(numLeaves);
+        if (numLeaves == 0 || numInnerNodes == 0) {
+            return -1;
+        }
+
+        std::vector<uint64_t> children, mergeTypes, labelIds(numLeaves);
+        children.reserve(2 * numInnerNodes);
+        mergeTypes.reserve(numInnerNodes);
+        for (uint nodeId = numLeaves + 1; nodeId < dag.nodes.size(); ++nodeId) {
+            const DagNode<std::string> &node = dag.nodes[nodeId];
+            if (node.left < 0) {
+                return -1;  // leaves don't come first
+            }
+            children.push_back(node.left);
+            children.push_back(node.right);
+            mergeTypes.push_back(node.mergeType);
+        }
+
+        // sort the labels so that neighbours share long prefixes
+        std::vector<std::pair<const std::string *, int>> sortedLabels;
+        sortedLabels.reserve(numLeaves);
+        for (int leaf = 1; leaf <= numLeaves; ++leaf) {
+            sortedLabels.emplace_back(dag.nodes[leaf].label, leaf);
+        }
+        std::sort(sortedLabels.begin(), sortedLabels.end(),
+                  [](const std::pair<const std::string *, int> &a, const std::pair<const std::string *, int> &b) {
+                      return *a.first < *b.first;
+                  });
+
+        BitWriter writer(fn);
+        if (!writer.good()) {
+            return -1;
+        }
+        FrontCodingWriter labelWriter(writer);
+        for (int rank = 0; rank < numLeaves; ++rank) {
+            labelIds[sortedLabels[rank].second - 1] = rank;
+            labelWriter.addItem(*sortedLabels[rank].first);
+        }
+
+        writeLittleEndian(writer, MAPPED_TOPDAG_MAGIC, 4);
+        writeLittleEndian(writer, MAPPED_TOPDAG_VERSION, 4);
+        writeLittleEndian(writer, FileWriter::countTreeNodes(dag), 8);
+        writeLittleEndian(writer, numLeaves, 4);
+        writeLittleEndian(writer, numInnerNodes, 4);
+        writeLittleEndian(writer, pointerWidth, 4);
+        writeLittleEndian(writer, labelWidth, 4);
+        writePacked(writer, children, pointerWidth);
+        writePacked(writer, mergeTypes, MAPPED_TOPDAG_MERGE_BITS);
+        writePacked(writer, labelIds, labelWidth);
+        writeLittleEndian(writer, labelWriter.getNumBytes(), 4);
+        labelWriter.writeBytes();
+        writer.write();
+        writer.close();
+
+        return writer.getBytesWritten() * 8;
+    }
+
+protected:
+    static void writeLittleEndian(BitWriter &writer, uint64_t value, const unsigned int bytes) {
+        for (unsigned int i = 0; i < bytes; ++i, value >>= 8) {
+            writer.writeBits(value & 0xff, 8);
+        }
+    }
+
+    static void writePacked(BitWriter &writer, const std::vector<uint64_t> &values, const unsigned int width) {
+        for (const uint64_t word : PackedArray::pack(values, width)) {
+            writeLittleEndian(writer, word, 8);
+        }
+    }
+};
+
+/// A Top DAG in a file written by MappedTopDagWriter, navigated in place via mmap
+/**
+ * Opening the file reads its header, indexes the label dictionary and checks the
+ * nodes in one pass: like FileReader, it rejects child pointers that don't point
+ * to a node with a smaller ID, unknown merge types and label IDs beyond the
+ * dictionary, so that good() files can be navigated safely. The nodes are then
+ * extracted from the mapped file when they are accessed, and the labels are
+ * decoded block by block when they are first accessed (see FrontCodedLabels).
+ * `nodes` behaves like the node vector of a TopDag whose elements are returned
+ * by value, so Navigator, PreorderQueries, PathQuery and TopDagAnalytics can be
+ * used with it as DAGType (with DataType std::string). Like FrozenTopDag, it is
+ * immutable and can be shared between threads.
+ */
+class MappedTopDag {
+public:
+    /// The DAG's nodes, decoded from the mapped file on access
+    class NodeArray {
+    public:
+        NodeArray() : children(), mergeTypes(), labelIds(), labels(NULL), numLeaves(0), numNodes(0) {}
+
+        /// The number of nodes, including the dummy node 0
+        size_t size() const {
+            return numNodes;
+        }
+
+        /// Extract a node. IDs outside the DAG (e.g., the root's parent -1, which
+        /// Navigator looks up) yield the dummy node 0.
+        DagNode<std::string> operator[](const size_t nodeId) const {
+            if (nodeId == 0 || nodeId >= numNodes) {
+                return DagNode<std::string>(-2, -2, NULL, NO_MERGE);
+            } else if (nodeId <= numLeaves) {
+                return DagNode<std::string>(-1, -1, &(*labels)[labelIds[nodeId - 1]], NO_MERGE);
+            }
+            const size_t inner = nodeId - numLeaves - 1;
+            return DagNode<std::string>((int)children[2 * inner], (int)children[2 * inner + 1], NULL,
+                                        (MergeType)mergeTypes[inner]);
+        }
+
+    protected:
+        friend class MappedTopDag;
+        PackedArray children, mergeTypes, labelIds;
+        const FrontCodedLabels *labels;
+        size_t numLeaves, numNodes;
+    };
+
+    /// Map a file and read its header and labels
+    MappedTopDag(const std::string &fn)
+        : nodes(), labels(), mapping(NULL), fileSize(0), numTreeNodes(0), ok(false) {
+        const int fd = open(fn.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+            fileSize = fileStat.st_size;
+            void *address = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            mapping = (address == MAP_FAILED) ? NULL : (const unsigned char *)address;
+        }
+        close(fd);
+        ok = (mapping != NULL) && readHeader();
+    }
+
+    ~MappedTopDag() {
+        if (mapping != NULL) {
+            munmap((void *)mapping, fileSize);
+        }
+    }
+
+    MappedTopDag(const MappedTopDag &) = delete;
+    MappedTopDag &operator=(const MappedTopDag &) = delete;
+
+    /// Whether the file could be mapped and its header, nodes and labels were valid
+    bool good() const {
+        return ok;
+    }
+
+    /// ID of the root node
+    int root() const {
+        return (int)nodes.size() - 1;
+    }
+
+    /// The number of nodes in the tree represented by the DAG
+    unsigned long long getNumTreeNodes() const {
+        return numTreeNodes;
+    }
+
+    /// The size of the file in bytes
+    size_t getFileSize() const {
+        return fileSize;
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const MappedTopDag &dag) {
+        os << "Mapped binary Dag with " << dag.nodes.size() - 1 << " nodes";
+        for (uint i = 1; i < dag.nodes.size(); ++i) {
+            os << "; " << i << "=" << dag.nodes[i];
+        }
+        return os;
+    }
+
+    NodeArray nodes;
+
+protected:
+    uint64_t readLittleEndian(const size_t offset, const unsigned int bytes) const {
+        uint64_t value(0);
+        for (unsigned int i = bytes; i > 0; --i) {
+            value = (value << 8) | mapping[offset + i - 1];
+        }
+        return value;
+    }
+
+    bool readHeader() {
+        if (fileSize < MAPPED_TOPDAG_HEADER_SIZE || readLittleEndian(0, 4) != MAPPED_TOPDAG_MAGIC ||
+            readLittleEndian(4, 4) != MAPPED_TOPDAG_VERSION) {
+            return false;
+        }
+        numTreeNodes = readLittleEndian(8, 8);
+        const uint64_t numLeaves = readLittleEndian(16, 4), numInnerNodes = readLittleEndian(20, 4);
+        const unsigned int pointerWidth = readLittleEndian(24, 4), labelWidth = readLittleEndian(28, 4);
+        const uint64_t numNodes = numLeaves + numInnerNodes + 1;
+        if (numLeaves == 0 || numInnerNodes == 0 || numNodes > (1ull << 31) || pointerWidth > 32 ||
+            (1ull << pointerWidth) < numNodes || labelWidth > 32 || (1ull << labelWidth) < numLeaves) {
+            return false;
+        }
+
+        // the sections follow each other, see MappedTopDagWriter
+        const size_t childrenOffset = MAPPED_TOPDAG_HEADER_SIZE;
+        const size_t mergeOffset = childrenOffset + PackedArray::bytesFor(2 * numInnerNodes, pointerWidth);
+        const size_t labelIdOffset = mergeOffset + PackedArray::bytesFor(numInnerNodes, MAPPED_TOPDAG_MERGE_BITS);
+        const size_t labelOffset = labelIdOffset + PackedArray::bytesFor(numLeaves, labelWidth);
+        if (labelOffset + 4 > fileSize) {
+            return false;
+        }
+        const uint64_t labelBytes = readLittleEndian(labelOffset, 4);
+        if (labelOffset + 4 + labelBytes != fileSize || !labels.map(mapping + labelOffset + 4, labelBytes, numLeaves)) {
+            return false;
+        }
+
+        const PackedArray children(mapping + childrenOffset, pointerWidth);
+        const PackedArray mergeTypes(mapping + mergeOffset, MAPPED_TOPDAG_MERGE_BITS);
+        const PackedArray labelIds(mapping + labelIdOffset, labelWidth);
+        // children can only be nodes that were completed before their parent
+        for (uint64_t inner = 0, nodeId = numLeaves + 1; inner < numInnerNodes; ++inner, ++nodeId) {
+            const uint64_t left = children[2 * inner], right = children[2 * inner + 1];
+            if (left == 0 || left >= nodeId || right == 0 || right >= nodeId || mergeTypes[inner] > HORZ_NO_BBN) {
+                return false;
+            }
+        }
+        for (uint64_t leaf = 0; leaf < numLeaves; ++leaf) {
+            if (labelIds[leaf] >= numLeaves) {
+                return false;
+            }
+        }
+
+        nodes.children = children;
+        nodes.mergeTypes = mergeTypes;
+        nodes.labelIds = labelIds;
+        nodes.labels = &labels;
+        nodes.numLeaves = numLeaves;
+        nodes.numNodes = numNodes;
+        return true;
+    }
+
+    FrontCodedLabels labels;
+    const unsigned char *mapping;
+    size_t fileSize;
+    unsigned long long numTreeNodes;
+    bool ok;
+};
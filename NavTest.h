@@ -6,10 +6,10 @@
 #include "TopDag.h"
 
 /// Traverse an in-memory Top DAG in preorder
-template <typename DataType>
+template <typename DataType, typename DAGType = TopDag<DataType>>
 class PreorderTraversal {
 public:
-    PreorderTraversal(const TopDag<DataType> &dag, const bool print=false) : nav(dag), print(print) {}
+    PreorderTraversal(const DAGType &dag, const bool print=false) : nav(dag), print(print) {}
 
     /// Do the traversal and print an XML representation to stdout
     std::pair<unsigned long long, unsigned long long> run() {
@@ -41,57 +41,59 @@ protected:
         std::cout << "</" << *nav.getLabel() << ">" << std::endl;
     }
 
-    /// Recursively traverse
+    /// Traverse iteratively (one step per node, so that deep trees don't exhaust the stack)
     unsigned long long traverse(int depth=0) {
         unsigned long long visited = 0;
-        if (!nav.isLeaf()) {
-            nav.firstChild();
-            ++visited;
-            openTag(++depth, !nav.isLeaf());
-        } else {
-            closeTag(depth, !nav.isLeaf());
-            if (nav.nextSibling()) {
+        while (true) {
+            if (!nav.isLeaf()) {
+                nav.firstChild();
                 ++visited;
-                openTag(depth, !nav.isLeaf());
+                openTag(++depth, !nav.isLeaf());
             } else {
-                while (!nav.nextSibling()) {
-                    bool hasParent = nav.parent();
-                    if (depth > 0) closeTag(--depth);
-                    if (!hasParent) return visited;
+                closeTag(depth, !nav.isLeaf());
+                if (nav.nextSibling()) {
+                    ++visited;
+                    openTag(depth, !nav.isLeaf());
+                } else {
+                    while (!nav.nextSibling()) {
+                        bool hasParent = nav.parent();
+                        if (depth > 0) closeTag(--depth);
+                        if (!hasParent) return visited;
+                    }
+                    ++visited;
+                    openTag(depth);
                 }
-                ++visited;
-                openTag(depth);
             }
         }
-        return visited + traverse(depth);
     }
 
-    /// Recursively traverse
+    /// Traverse iteratively, children from right to left
     size_t traverseRight(int depth=0) {
         size_t visited = 0;
-        if (!nav.isLeaf()) {
-            nav.lastChild();
-            ++visited;
-            openTag(++depth, !nav.isLeaf());
-        } else {
-            closeTag(depth, !nav.isLeaf());
-            if (nav.prevSibling()) {
+        while (true) {
+            if (!nav.isLeaf()) {
+                nav.lastChild();
                 ++visited;
-                openTag(depth, !nav.isLeaf());
+                openTag(++depth, !nav.isLeaf());
             } else {
-                while (!nav.prevSibling()) {
-                    bool hasParent = nav.parent();
-                    if (depth > 0) closeTag(--depth);
-                    if (!hasParent) return visited;
+                closeTag(depth, !nav.isLeaf());
+                if (nav.prevSibling()) {
+                    ++visited;
+                    openTag(depth, !nav.isLeaf());
+                } else {
+                    while (!nav.prevSibling()) {
+                        bool hasParent = nav.parent();
+                        if (depth > 0) closeTag(--depth);
+                        if (!hasParent) return visited;
+                    }
+                    ++visited;
+                    openTag(depth);
                 }
-                ++visited;
-                openTag(depth);
             }
         }
-        return visited + traverseRight(depth);
     }
 
 protected:
-    Navigator<DataType> nav;
+    Navigator<DataType, DAGType> nav;
     const bool print;
 };
@@ -3,6 +3,9 @@
 #include <cassert>
 #include <stack>
 
+#include <vector>
+
+#include "FrozenTopDag.h"
 #include "TopDag.h"
 
 /// Represents an entry in the DAG stack
@@ -24,11 +27,17 @@ struct NavigationRecord {
 };
 
 /// Navigate around in an in-memory Top DAG
-template <typename DataType>
+/**
+ * The navigator only reads from the DAG, all navigation state is kept in
+ * the navigator itself. Several navigators can thus be used on the same DAG
+ * from different threads concurrently, as long as the DAG is not modified
+ * (use a FrozenTopDag to ensure this, see DagCursor). A MappedTopDag can
+ * be navigated in place as well.
+ */
+template <typename DataType, typename DAGType = TopDag<DataType>>
 class Navigator {
 public:
-    using DAGType = TopDag<DataType>;
-    using DStackT = std::stack<NavigationRecord>;
+    using DStackT = std::stack<NavigationRecord, std::vector<NavigationRecord>>;
     using TStackT = std::deque<DStackT>;
 
     /// Create a new navigator for the given Top DAG
@@ -282,3 +291,7 @@ private:
     unsigned long long maxTreeStackSize;
     static const bool verbose = false;
 };
+
+/// A cursor into a FrozenTopDag. Use one per thread, they can share the DAG.
+template <typename DataType>
+using DagCursor = Navigator<DataType, FrozenTopDag<DataType>>;
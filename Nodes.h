@@ -17,9 +17,10 @@ struct TreeNode {
     int lastEdgeIndex;
     int parent;
     int lastMergedIn;
-    uint hash;
+    /// the Top DAG node of the node's cluster, see NodeHasher
+    uint dagId;
 
-    TreeNode() : firstEdgeIndex(-1), lastEdgeIndex(-1), parent(-1), lastMergedIn(-1), hash(0) {}
+    TreeNode() : firstEdgeIndex(-1), lastEdgeIndex(-1), parent(-1), lastMergedIn(-1), dagId(0) {}
 
     /// Get the number of outgoing edges (both valid and invalid)
     int numEdges() const {
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+/// Run independent tasks concurrently, one thread each (the first one in the calling thread),
+/// and wait until all of them have finished
+inline void runInParallel(const std::vector<std::function<void (void)>> &tasks) {
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < tasks.size(); ++i) {
+        workers.push_back(std::thread(tasks[i]));
+    }
+    if (!tasks.empty()) {
+        tasks[0]();
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ClusterSizes.h"
+#include "Common.h"
+#include "TopDag.h"
+
+using std::vector;
+
+/// One location step of a path query, e.g. "/author" or "//title"
+template <typename DataType>
+struct PathStep {
+    PathStep() : descendant(false), wildcard(true), label() {}
+    PathStep(const bool descendant, const bool wildcard, const DataType &label)
+        : descendant(descendant), wildcard(wildcard), label(label) {}
+
+    /// Check whether a node with the given label satisfies this step's node test
+    bool matches(const DataType &other) const {
+        return wildcard || label == other;
+    }
+
+    /// whether this step uses the descendant axis ("//") instead of the child axis ("/")
+    bool descendant;
+    /// whether this step matches any label ("*")
+    bool wildcard;
+    DataType label;
+
+    friend std::ostream &operator<<(std::ostream &os, const PathStep &step) {
+        os << (step.descendant ? "//" : "/");
+        if (step.wildcard)
+            return os << "*";
+        return os << step.label;
+    }
+};
+
+/// Parse XPath-lite expressions consisting of child ("/") and descendant ("//")
+/// steps with label or wildcard ("*") node tests, e.g. "/dblp/article/author" or "//title"
+struct PathQueryParser {
+    /// Parse a query
+    /// \param query the query string
+    /// \param steps will hold the query's steps
+    /// \return whether the query was well-formed
+    static bool parse(const std::string &query, vector<PathStep<std::string>> &steps) {
+        steps.clear();
+        size_t pos(0);
+        while (pos < query.size()) {
+            if (query[pos] != '/') {
+                return false;
+            }
+            bool descendant(false);
+            if (++pos < query.size() && query[pos] == '/') {
+                descendant = true;
+                ++pos;
+            }
+            const size_t end = std::min(query.find('/', pos), query.size());
+            if (end == pos) {
+                // empty node test
+                return false;
+            }
+            const std::string label(query.substr(pos, end - pos));
+            steps.emplace_back(descendant, label == "*", label);
+            pos = end;
+        }
+        return !steps.empty();
+    }
+};
+
+/// Evaluate a path query on a Top DAG without unpacking it
+/**
+ * The query is compiled into a lazily determinised automaton whose states
+ * are the sets of query steps that the children of a node may match next.
+ * A cluster that hangs below a node in state q contributes the same number
+ * of matches and passes the same state to its bottom boundary node wherever
+ * it occurs, so each DAG node is evaluated at most once per state and the
+ * cost is proportional to the size of the DAG, not the tree.
+ *
+ * The DAG can also be a MappedTopDag, which is queried in place.
+ */
+template <typename DataType, typename DAGType = TopDag<DataType>>
+class PathQuery {
+    typedef uint64_t StateSet;
+
+    /// Result of evaluating a cluster in a given state
+    struct Result {
+        Result(const unsigned long long count = 0, const int boundaryState = 0)
+            : count(count), boundaryState(boundaryState) {}
+        /// number of matches within the cluster
+        unsigned long long count;
+        /// state passed on to the cluster's bottom boundary node
+        int boundaryState;
+    };
+
+public:
+    /// Compile a query for evaluation on a Top DAG
+    /// \param dag the Top DAG to query. Must be final (no more clusters added)
+    /// \param steps the query's steps (at most 63)
+    PathQuery(const DAGType &dag, const vector<PathStep<DataType>> &steps)
+        : dag(dag), steps(steps), matchBit((StateSet)1 << steps.size()), states(), stateIds(), memo(),
+          sizes() {
+        assert(!steps.empty() && steps.size() < 64);
+        // state 0 is the dead state in which nothing can match any more
+        getStateId(0);
+        initialState = getStateId(1);
+    }
+
+    /// Count the number of tree nodes matching the query
+    unsigned long long count() {
+        return evaluate(dag.nodes.size() - 1, initialState).count;
+    }
+
+    /// Retrieve the preorder numbers of the tree nodes matching the query (root = 0),
+    /// in ascending order. Costs O(|DAG| + number of matches * top DAG height).
+    /// \param positions output vector, matches will be appended
+    void positions(vector<unsigned long long> &positions) {
+        sizes.compute(dag);
+        const int root = dag.nodes.size() - 1;
+        const size_t oldSize = positions.size();
+        collectPositions(root, initialState, 0, sizes.preSizes[root], positions);
+        // vertical merges interleave the right child's nodes with the left child's
+        std::sort(positions.begin() + oldSize, positions.end());
+    }
+
+    /// The number of automaton states that were materialised
+    size_t numStates() const {
+        return states.size();
+    }
+
+    /// The number of (DAG node, state) pairs that were evaluated
+    size_t numEvaluations() const {
+        return memo.size();
+    }
+
+protected:
+    /// Get the ID of a set of active query steps, creating a new state if necessary
+    int getStateId(const StateSet set) {
+        auto it = stateIds.find(set);
+        if (it == stateIds.end()) {
+            it = stateIds.insert(std::make_pair(set, (int)states.size())).first;
+            states.push_back(set);
+        }
+        return it->second;
+    }
+
+    /// Evaluate a cluster that hangs below a node whose children may match the steps in `stateId`
+    Result evaluate(const int nodeId, const int stateId) {
+        if (stateId == 0) {
+            return Result();
+        }
+        const uint64_t key = ((uint64_t)nodeId << 32) | (uint32_t)stateId;
+        auto it = memo.find(key);
+        if (it != memo.end()) {
+            return it->second;
+        }
+
+        const DagNode<DataType> &node = dag.nodes[nodeId];
+        Result result;
+        if (node.left < 0) {
+            result = evaluateLeaf(*node.label, stateId);
+        } else {
+            const Result left = evaluate(node.left, stateId);
+            switch (node.mergeType) {
+            case VERT_WITH_BBN:
+            case VERT_NO_BBN: {
+                // right cluster hangs below the left cluster's boundary node
+                const Result right = evaluate(node.right, left.boundaryState);
+                result.count = left.count + right.count;
+                result.boundaryState = (node.mergeType == VERT_WITH_BBN) ? right.boundaryState : 0;
+                break;
+            }
+            case HORZ_LEFT_BBN:
+            case HORZ_RIGHT_BBN:
+            case HORZ_NO_BBN: {
+                // siblings, both hang below the same node
+                const Result right = evaluate(node.right, stateId);
+                result.count = left.count + right.count;
+                result.boundaryState = (node.mergeType == HORZ_LEFT_BBN) ? left.boundaryState :
+                                       (node.mergeType == HORZ_RIGHT_BBN) ? right.boundaryState : 0;
+                break;
+            }
+            default:
+                assert(false);
+            }
+        }
+
+        memo[key] = result;
+        return result;
+    }
+
+    /// Evaluate a single tree node
+    Result evaluateLeaf(const DataType &label, const int stateId) {
+        const StateSet active = states[stateId];
+        StateSet matched(0), kept(0);
+        for (uint step = 0; step < steps.size(); ++step) {
+            if ((active & ((StateSet)1 << step)) == 0) continue;
+            if (steps[step].matches(label)) {
+                matched |= (StateSet)1 << (step + 1);
+            }
+            if (steps[step].descendant) {
+                // descendant steps may still be matched further down
+                kept |= (StateSet)1 << step;
+            }
+        }
+        return Result((matched & matchBit) != 0, getStateId((matched | kept) & ~matchBit));
+    }
+
+    /// Collect the preorder numbers of a cluster's matches
+    /// \param preStart preorder number of the cluster's first node
+    /// \param postStart preorder number of the first node following the subtree below the boundary node
+    void collectPositions(const int nodeId, const int stateId, const unsigned long long preStart,
+                          const unsigned long long postStart, vector<unsigned long long> &positions) {
+        const Result result = evaluate(nodeId, stateId);
+        if (result.count == 0) return;
+
+        const DagNode<DataType> &node = dag.nodes[nodeId];
+        if (node.left < 0) {
+            positions.push_back(preStart);
+            return;
+        }
+
+        const unsigned long long leftPre(sizes.preSizes[node.left]), leftPost(sizes.postSizes[node.left]);
+        const unsigned long long rightPre(sizes.preSizes[node.right]), rightPost(sizes.postSizes[node.right]);
+        switch (node.mergeType) {
+        case VERT_WITH_BBN:
+        case VERT_NO_BBN:
+            collectPositions(node.left, stateId, preStart, postStart + rightPost, positions);
+            collectPositions(node.right, evaluate(node.left, stateId).boundaryState, preStart + leftPre, postStart,
+                             positions);
+            break;
+        case HORZ_LEFT_BBN:
+            collectPositions(node.left, stateId, preStart, postStart, positions);
+            collectPositions(node.right, stateId, postStart + leftPost, postStart + leftPost + rightPre, positions);
+            break;
+        case HORZ_RIGHT_BBN:
+            collectPositions(node.left, stateId, preStart, preStart + leftPre, positions);
+            collectPositions(node.right, stateId, preStart + leftPre + leftPost, postStart, positions);
+            break;
+        case HORZ_NO_BBN:
+            collectPositions(node.left, stateId, preStart, preStart + leftPre, positions);
+            collectPositions(node.right, stateId, preStart + leftPre + leftPost,
+                             preStart + leftPre + leftPost + rightPre, positions);
+            break;
+        default:
+            assert(false);
+        }
+    }
+
+    const DAGType &dag;
+    const vector<PathStep<DataType>> steps;
+    const StateSet matchBit;
+    int initialState;
+    vector<StateSet> states;
+    std::unordered_map<StateSet, int> stateIds;
+    std::unordered_map<uint64_t, Result> memo;
+    ClusterSizes sizes;
+};
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cassert>
+#include <vector>
+
+#include "ClusterSizes.h"
+#include "Common.h"
+#include "TopDag.h"
+
+using std::vector;
+
+/// Answer parent, depth and lowest common ancestor queries on the preorder numbers
+/// of the tree represented by a Top DAG, without unpacking it
+/**
+ * Every query descends from the root cluster to the leaf cluster(s) of the
+ * queried node(s), so it takes O(height of the top DAG) time independently
+ * of any navigation state. The annotations needed for this are computed
+ * once in O(|DAG|) on construction.
+ *
+ * Preorder numbers start at 0 for the root. The root has depth 1 (as in
+ * OrderedTree::height()) and no parent (-1).
+ *
+ * All queries are const, so one instance can be shared between threads if
+ * the DAG is not modified (e.g., a FrozenTopDag or MappedTopDag).
+ */
+template <typename DataType, typename DAGType = TopDag<DataType>>
+class PreorderQueries {
+    /// Where a cluster occurs in the tree
+    struct Position {
+        Position(const long long preStart, const long long postStart, const long long attachment,
+                 const uint attachmentDepth)
+            : preStart(preStart), postStart(postStart), attachment(attachment), attachmentDepth(attachmentDepth) {}
+        /// preorder number of the cluster's first node
+        long long preStart;
+        /// preorder number of the first node following the subtree below the boundary node
+        long long postStart;
+        /// preorder number of the node the cluster hangs below (-1 for the root cluster)
+        long long attachment;
+        /// depth of the node the cluster hangs below (0 for the root cluster)
+        uint attachmentDepth;
+    };
+
+public:
+    /// Annotate a Top DAG for queries
+    /// \param dag the Top DAG. Must be final (no more clusters added)
+    PreorderQueries(const DAGType &dag) : dag(dag), sizes() {
+        sizes.compute(dag);
+    }
+
+    /// The number of nodes in the tree
+    long long numNodes() const {
+        return sizes.size(root());
+    }
+
+    /// Preorder number of a node's parent, or -1 for the root
+    long long parent(const long long k) const {
+        return findLeaf(k).attachment;
+    }
+
+    /// Depth of a node (the root has depth 1)
+    uint depth(const long long k) const {
+        return findLeaf(k).attachmentDepth + 1;
+    }
+
+    /// Label of a node
+    const DataType *getLabel(const long long k) const {
+        int nodeId(root());
+        Position pos(rootPosition());
+        while (dag.nodes[nodeId].left >= 0) {
+            descend(nodeId, pos, k);
+        }
+        return dag.nodes[nodeId].label;
+    }
+
+    /// Preorder number of the lowest common ancestor of two nodes
+    long long lca(long long k1, long long k2) const {
+        assert(contains(root(), rootPosition(), k1) && contains(root(), rootPosition(), k2));
+        int nodeId(root());
+        Position pos(rootPosition());
+        while (k1 != k2) {
+            const DagNode<DataType> &node = dag.nodes[nodeId];
+            // k1 != k2, so the current cluster has at least two nodes and is no leaf
+            const Position leftPos(leftPosition(nodeId, pos));
+            const bool leftHas1(contains(node.left, leftPos, k1)), leftHas2(contains(node.left, leftPos, k2));
+            if (leftHas1 != leftHas2) {
+                if (node.mergeType == VERT_WITH_BBN || node.mergeType == VERT_NO_BBN) {
+                    // the node in the right cluster is a descendant of the left cluster's boundary node,
+                    // so replace it by the boundary node and continue in the left cluster
+                    const long long boundary = rightPosition(nodeId, pos).attachment;
+                    (leftHas1 ? k2 : k1) = boundary;
+                } else {
+                    // siblings: both nodes are in different subtrees below the same node
+                    return pos.attachment;
+                }
+            }
+            if (leftHas1 || leftHas2) {
+                nodeId = node.left;
+                pos = leftPos;
+            } else {
+                pos = rightPosition(nodeId, pos);
+                nodeId = node.right;
+            }
+        }
+        return k1;
+    }
+
+protected:
+    int root() const {
+        return (int)dag.nodes.size() - 1;
+    }
+
+    /// the root cluster hangs below a virtual node at depth 0
+    Position rootPosition() const {
+        return Position(0, preSize(root()), -1, 0);
+    }
+
+    /// Check whether a cluster occurring at the given position contains node k
+    bool contains(const int nodeId, const Position &pos, const long long k) const {
+        return (k >= pos.preStart && k < pos.preStart + preSize(nodeId)) ||
+               (k >= pos.postStart && k < pos.postStart + postSize(nodeId));
+    }
+
+    /// Position of a cluster's left child
+    Position leftPosition(const int nodeId, const Position &pos) const {
+        const DagNode<DataType> &node = dag.nodes[nodeId];
+        switch (node.mergeType) {
+        case VERT_WITH_BBN:
+        case VERT_NO_BBN:
+            return Position(pos.preStart, pos.postStart + postSize(node.right), pos.attachment, pos.attachmentDepth);
+        case HORZ_LEFT_BBN:
+            return pos;
+        case HORZ_RIGHT_BBN:
+        case HORZ_NO_BBN:
+            return Position(pos.preStart, pos.preStart + preSize(node.left), pos.attachment, pos.attachmentDepth);
+        default:
+            assert(false);
+            return pos;
+        }
+    }
+
+    /// Position of a cluster's right child
+    Position rightPosition(const int nodeId, const Position &pos) const {
+        const DagNode<DataType> &node = dag.nodes[nodeId];
+        const long long leftPre(preSize(node.left)), leftPost(postSize(node.left));
+        switch (node.mergeType) {
+        case VERT_WITH_BBN:
+        case VERT_NO_BBN:
+            // hangs below the left cluster's boundary node, which is the last node of its pre part
+            return Position(pos.preStart + leftPre, pos.postStart, pos.preStart + leftPre - 1,
+                            pos.attachmentDepth + sizes.boundaryDepths[node.left]);
+        case HORZ_LEFT_BBN:
+            return Position(pos.postStart + leftPost, pos.postStart + leftPost + preSize(node.right),
+                            pos.attachment, pos.attachmentDepth);
+        case HORZ_RIGHT_BBN:
+            return Position(pos.preStart + leftPre + leftPost, pos.postStart, pos.attachment, pos.attachmentDepth);
+        case HORZ_NO_BBN: {
+            const long long rightStart = pos.preStart + leftPre + leftPost;
+            return Position(rightStart, rightStart + preSize(node.right), pos.attachment, pos.attachmentDepth);
+        }
+        default:
+            assert(false);
+            return pos;
+        }
+    }
+
+    /// Move from a cluster to the child cluster containing node k
+    void descend(int &nodeId, Position &pos, const long long k) const {
+        const DagNode<DataType> &node = dag.nodes[nodeId];
+        const Position leftPos(leftPosition(nodeId, pos));
+        if (contains(node.left, leftPos, k)) {
+            nodeId = node.left;
+            pos = leftPos;
+        } else {
+            pos = rightPosition(nodeId, pos);
+            nodeId = node.right;
+        }
+    }
+
+    /// Find the position of the leaf cluster of node k
+    Position findLeaf(const long long k) const {
+        assert(k >= 0 && k < numNodes());
+        int nodeId(root());
+        Position pos(rootPosition());
+        while (dag.nodes[nodeId].left >= 0) {
+            descend(nodeId, pos, k);
+        }
+        assert(pos.preStart == k);
+        return pos;
+    }
+
+    /// The number of a cluster's nodes before / after the subtree below its boundary node, see ClusterSizes
+    long long preSize(const int nodeId) const {
+        return sizes.preSizes[nodeId];
+    }
+
+    long long postSize(const int nodeId) const {
+        return sizes.postSizes[nodeId];
+    }
+
+    const DAGType &dag;
+    ClusterSizes sizes;
+};
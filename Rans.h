@@ -0,0 +1,364 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+
+#include "BitReader.h"
+#include "BitWriter.h"
+#include "Common.h"
+#include "Histogram.h"
+
+/// Parameters of the rANS coder shared by RansWriter and RansReader
+/**
+ * Range asymmetric numeral systems with a static model, 64-bit states and 32-bit
+ * renormalisation (following Fabian Giesen's rans64). Two states are interleaved
+ * so that the decoder's dependency chains can overlap. Unlike Huffman codes,
+ * rANS spends fractional bits per symbol, so skewed distributions are coded
+ * close to their entropy without blocking symbols.
+ *
+ * A stream consists of the model (number of symbols, scale, and the symbols in
+ * ascending order, each as the gamma-coded difference to its predecessor followed
+ * by its gamma-coded normalised frequency), the encoder's final states, and the renormalisation
+ * words in the order in which the decoder consumes them. The stream's end is
+ * implicit: decoding as many symbols as were written reads exactly all words.
+ */
+struct RansCoder {
+    /// lower bound of the normalised state interval [L, L << 32)
+    static const uint64_t stateLowerBound = 1ull << 31;
+    static const unsigned int numStates = 2;
+    /// the frequencies are normalised to sum up to 2^scaleBits, with scaleBits at most this (so
+    /// that a symbol's state interval [L / 2^scaleBits * freq, ...) is not empty), which allows
+    /// for up to 2^30 different symbols
+    static const unsigned int maxScaleBits = 31;
+    /// the scale used for streams with many items (unless there are many symbols)
+    static const unsigned int defaultScaleBits = 16;
+};
+
+/// Buffers symbols and writes them rANS-coded, including the model, see RansCoder
+/**
+ * The symbols are counted with a Histogram like HuffmanBuilder does, and numbered
+ * with SymbolIds when the buffer is written.
+ */
+template <typename SymbolType>
+class RansWriter {
+    typedef typename std::make_unsigned<SymbolType>::type UnsignedType;
+public:
+    RansWriter(BitWriter &writer) : writer(writer), histogram(), symbols(), counts(), freqs(), sequence() {}
+
+    void addItem(const SymbolType &symbol) {
+        histogram.addItem(symbol);
+        sequence.push_back(symbol);
+    }
+
+    template <typename InputIterator>
+    void addItems(InputIterator begin, InputIterator end) {
+        const size_t first = sequence.size();
+        sequence.insert(sequence.end(), begin, end);
+        histogram.addItems(sequence.cbegin() + first, sequence.cend());
+    }
+
+    /// Write the model and the coded symbols, and clear the buffer
+    void writeBuffer() {
+        symbols.assign(histogram);
+        counts.clear();
+        counts.reserve(symbols.size());
+        histogram.forEach([this](const SymbolType &, const uint64_t count) {
+            counts.push_back(count);
+        });
+        writer.writeBits(symbols.size(), 32);
+        if (!symbols.empty()) {
+            const unsigned int scaleBits = normalise();
+            writer.writeBits(scaleBits, 5);
+            // the symbols' slots are assigned in ascending order of the symbols
+            std::vector<int> order(symbols.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [this](const int a, const int b) {
+                return (UnsignedType)symbols.symbol(a) < (UnsignedType)symbols.symbol(b);
+            });
+            std::vector<uint32_t> starts(symbols.size());
+            uint32_t start(0);
+            uint64_t previous(0);
+            for (const int symbolId : order) {
+                // the first symbol may be 0, so code its value + 1
+                const uint64_t value = (UnsignedType)symbols.symbol(symbolId);
+                writer.writeGamma(value + (start == 0) - previous);
+                writer.writeGamma(freqs[symbolId]);
+                previous = value;
+                starts[symbolId] = start;
+                start += freqs[symbolId];
+            }
+            encode(scaleBits, starts);
+        }
+        histogram.clear();
+        symbols.clear();
+        counts.clear();
+        sequence.clear();
+    }
+
+protected:
+    /// Normalise the symbol counts to frequencies that sum up to a power of two (at least 1 each)
+    /// \return the power
+    unsigned int normalise() {
+        const int minScaleBits = bitsFor(symbols.size()) + 1;
+        if (minScaleBits > (int)RansCoder::maxScaleBits) {
+            std::cerr << "rANS can't code " << symbols.size() << " different symbols, at most "
+                      << (1ull << (RansCoder::maxScaleBits - 1)) << " are supported" << std::endl;
+            std::abort();
+        }
+        const unsigned int scaleBits = std::max(minScaleBits,
+            std::min(bitsFor(sequence.size()), (int)RansCoder::defaultScaleBits));
+        const uint64_t total = 1ull << scaleBits;
+
+        freqs.resize(symbols.size());
+        uint64_t sum(0);
+        for (uint i = 0; i < symbols.size(); ++i) {
+            freqs[i] = std::max<uint64_t>(1, counts[i] * total / sequence.size());
+            sum += freqs[i];
+        }
+
+        // Fix the rounding errors in proportion to the frequencies (a symbol keeps at least 1), and
+        // the rest of them (less than one per symbol) at the most frequent symbols
+        const uint64_t roundedSum(sum);
+        if (sum < total) {
+            const uint64_t missing = total - sum;
+            for (uint i = 0; i < symbols.size(); ++i) {
+                const uint64_t add = missing * freqs[i] / roundedSum;
+                freqs[i] += add;
+                sum += add;
+            }
+        } else if (sum > total) {
+            // the symbols can give up sum - numSymbols >= sum - total in total
+            const uint64_t excess = sum - total, available = sum - symbols.size();
+            for (uint i = 0; i < symbols.size(); ++i) {
+                const uint64_t take = excess * (freqs[i] - 1) / available;
+                freqs[i] -= take;
+                sum -= take;
+            }
+        }
+        std::vector<int> order(symbols.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [this](const int a, const int b) { return counts[a] > counts[b]; });
+        for (uint i = 0; sum < total; i = (i + 1) % order.size()) {
+            freqs[order[i]]++;
+            sum++;
+        }
+        for (uint i = 0; sum > total; i = (i + 1) % order.size()) {
+            if (freqs[order[i]] > 1) {
+                freqs[order[i]]--;
+                sum--;
+            }
+        }
+        return scaleBits;
+    }
+
+    /// Encode the symbols in reverse and write the final states and renormalisation words
+    /// \param starts the first slot of each symbol
+    void encode(const unsigned int scaleBits, const std::vector<uint32_t> &starts) {
+        std::vector<uint32_t> words;
+        uint64_t states[RansCoder::numStates];
+        const uint64_t initialState = RansCoder::stateLowerBound;
+        std::fill(states, states + RansCoder::numStates, initialState);
+        const uint64_t boundFactor = (RansCoder::stateLowerBound >> scaleBits) << 32;
+        for (size_t i = sequence.size(); i--;) {
+            uint64_t &state = states[i % RansCoder::numStates];
+            const int symbolId = symbols[sequence[i]];
+            const uint64_t freq = freqs[symbolId];
+            if (state >= boundFactor * freq) {
+                words.push_back((uint32_t)state);
+                state >>= 32;
+            }
+            state = ((state / freq) << scaleBits) + (state % freq) + starts[symbolId];
+        }
+
+        for (const uint64_t state : states) {
+            writer.writeBits(state, 64);
+        }
+        for (size_t i = words.size(); i--;) {
+            writer.writeBits(words[i], 32);
+        }
+    }
+
+    BitWriter &writer;
+    Histogram<SymbolType> histogram;
+    SymbolIds<SymbolType> symbols;
+    std::vector<uint64_t> counts, freqs;
+    /// the items added
+    std::vector<SymbolType> sequence;
+};
+
+/// Decoder for streams written by RansWriter
+template <typename SymbolType>
+class RansReader {
+public:
+    RansReader() : symbols(), freqs(), starts(), slotSymbols(), scaleBits(0), nextState(0), error(false) {}
+
+    /// Read the model and the initial states
+    /// \param reader the BitReader to read from
+    /// \return whether the model was well-formed
+    bool readTable(BitReader &reader) {
+        symbols.clear();
+        freqs.clear();
+        starts.clear();
+        nextState = 0;
+        error = false;
+        const uint64_t numSymbols = reader.readBits(32);
+        if (numSymbols == 0) return !reader.overrun();
+
+        scaleBits = reader.readBits(5);
+        // the encoder only uses more than defaultScaleBits if there are many symbols, which bounds the slot table's size
+        const unsigned int maxScaleBits = std::max<int>(RansCoder::defaultScaleBits, bitsFor(numSymbols) + 1);
+        if (scaleBits > std::min(maxScaleBits, RansCoder::maxScaleBits) || numSymbols > (1ull << scaleBits)) return false;
+        uint64_t total(0), value(0);
+        for (uint64_t i = 0; i < numSymbols && !reader.overrun(); ++i) {
+            const uint64_t delta = reader.readGamma(), freq = reader.readGamma();
+            if (delta == 0 || freq == 0 || total + freq > (1ull << scaleBits)) return false;
+            value += delta - (i == 0);
+            symbols.push_back((SymbolType)value);
+            freqs.push_back(freq);
+            starts.push_back(total);
+            total += freq;
+        }
+        if (reader.overrun() || total != (1ull << scaleBits)) return false;
+
+        slotSymbols.resize(total);
+        for (uint i = 0; i < symbols.size(); ++i) {
+            std::fill(slotSymbols.begin() + starts[i], slotSymbols.begin() + starts[i] + freqs[i], i);
+        }
+        for (uint64_t &state : states) {
+            state = reader.readBits(64);
+            if (state < RansCoder::stateLowerBound) return false;
+        }
+        return !reader.overrun();
+    }
+
+    /// Decode one symbol
+    SymbolType decode(BitReader &reader) {
+        assert(!symbols.empty());
+        uint64_t &state = states[nextState];
+        nextState = (nextState + 1) % RansCoder::numStates;
+        const uint32_t slot = state & ((1ull << scaleBits) - 1);
+        const uint32_t symbolId = slotSymbols[slot];
+        state = freqs[symbolId] * (state >> scaleBits) + slot - starts[symbolId];
+        if (state < RansCoder::stateLowerBound) {
+            state = (state << 32) | reader.readBits(32);
+        }
+        return symbols[symbolId];
+    }
+
+    /// Decode `count` symbols and append them to `items`
+    template <typename ItemType>
+    void decode(BitReader &reader, size_t count, std::vector<ItemType> &items) {
+        items.reserve(items.size() + count);
+        for (; count > 0; --count) {
+            items.push_back(decode(reader));
+        }
+    }
+
+    /// Check that all symbols were decoded: the encoder started with the states we must end with
+    bool finish() {
+        for (const uint64_t state : states) {
+            error = error || (!symbols.empty() && state != RansCoder::stateLowerBound);
+        }
+        return !error;
+    }
+
+    /// Get the number of different symbols in the model
+    int getNumSymbols() const {
+        return symbols.size();
+    }
+
+protected:
+    std::vector<SymbolType> symbols;
+    std::vector<uint64_t> freqs, starts;
+    /// symbol index for each slot in [0, 2^scaleBits), at most max(2^16, 4 * numSymbols) slots
+    std::vector<uint32_t> slotSymbols;
+    unsigned int scaleBits;
+    uint64_t states[RansCoder::numStates];
+    unsigned int nextState;
+    bool error;
+};
+
+/// Writer for blocked rANS streams: combines inputSize-bit items into outputSize-bit blocks
+/// like BlockedHuffmanWriter, and codes the blocks with a RansWriter
+template <typename InputType, typename OutputType, int inputSize = sizeof(InputType)*8, int outputSize = sizeof(OutputType)*8>
+class BlockedRansWriter {
+public:
+    BlockedRansWriter(BitWriter &writer) : blockingFactor(outputSize / inputSize), rans(writer), block(), blockSize(0) {
+        assert(outputSize % inputSize == 0);
+    }
+
+    void addItem(const InputType &symbol) {
+        block |= ((OutputType)symbol << (blockSize * inputSize));
+        if (++blockSize == blockingFactor) {
+            flushBlock();
+        }
+    }
+
+    template <class InputIterator>
+    void addItems(InputIterator begin, InputIterator end) {
+        for (auto it = begin; it != end; ++it) {
+            addItem(*it);
+        }
+    }
+
+    /// Write the model and the coded blocks, the last one filled up with zeroes
+    void writeBuffer() {
+        if (blockSize > 0) {
+            flushBlock();
+        }
+        rans.writeBuffer();
+    }
+
+protected:
+    void flushBlock() {
+        rans.addItem(block);
+        block = OutputType{};
+        blockSize = 0;
+    }
+
+    const uint blockingFactor;
+    RansWriter<OutputType> rans;
+    OutputType block;
+    uint blockSize;
+};
+
+/// Decoder for blocked rANS streams written by BlockedRansWriter
+template <typename InputType, typename OutputType, int inputSize = sizeof(InputType)*8, int outputSize = sizeof(OutputType)*8>
+class BlockedRansReader {
+public:
+    BlockedRansReader() : blockingFactor(outputSize / inputSize), rans() {
+        assert(outputSize % inputSize == 0);
+    }
+
+    /// Read the model, see RansReader::readTable()
+    bool readTable(BitReader &reader) {
+        return rans.readTable(reader);
+    }
+
+    /// Decode `count` items and append them to `items`
+    void decode(BitReader &reader, const size_t count, std::vector<InputType> &items) {
+        const uint64_t mask = (inputSize >= 64) ? ~0ull : ((1ull << inputSize) - 1);
+        size_t decoded(0);
+        while (decoded < count) {
+            const OutputType block = rans.decode(reader);
+            for (uint i = 0; i < blockingFactor && decoded < count; ++i, ++decoded) {
+                items.push_back((InputType)((block >> (i * inputSize)) & mask));
+            }
+        }
+    }
+
+    /// See RansReader::finish()
+    bool finish() {
+        return rans.finish();
+    }
+
+protected:
+    const uint blockingFactor;
+    RansReader<OutputType> rans;
+};
@@ -1,94 +1,163 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <functional>
 #include <ostream>
-#include <set>
-#include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 #include "Common.h"
+#include "Parallel.h"
 
 namespace SimpleRePair {
 
-/// Combine hash values
-struct HashCombiner {
-    /// Combine two hash values into a new hash
-    uint operator()(const uint leftHash, const uint rightHash) const {
-        return hash(leftHash, rightHash);
+/// Keys of RePair pairs
+/**
+ * A pair of sibling clusters is keyed exactly by the IDs of the clusters'
+ * nodes in the Top DAG, which stores every distinct cluster only once. So two
+ * pairs have the same key iff they consist of equal clusters, there are no
+ * collisions. For hash tables, the keys are scrambled with a multiply-xorshift
+ * function (see operator()), as their bits are far from uniform.
+ */
+struct PairKey {
+    /// The key of a pair of clusters
+    /// \param left Top DAG node ID of the left cluster
+    /// \param right Top DAG node ID of the right cluster
+    static uint64_t make(const uint left, const uint right) {
+        return ((uint64_t)left << 32) | right;
     }
 
-    /// Combine two hash values into a new hash
-    static uint hash(const uint leftHash, const uint rightHash) {
-        uint seed(0);
-        boost_hash_combine(seed, leftHash);
-        boost_hash_combine(seed, rightHash);
-        return seed;
+    /// Scramble a key (a bijection, see splitmix64)
+    static uint64_t mix(uint64_t key) {
+        key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+        return key ^ (key >> 31);
+    }
+
+    /// Hash a key for a hash map
+    size_t operator()(const uint64_t key) const {
+        return mix(key);
     }
 };
 
-/// A RePair record consisting of a hash value, a frequency, and an occurence list
+/// A RePair record consisting of a pair key (see PairKey), a frequency, and the position of its
+/// occurrences in the occurrence array of its Records
 template <typename Pair>
 struct Record {
-    Record(const uint hash = 0) : hash(hash), frequency(0), occurrences() {}
-    Record(const Record<Pair> &other) : hash(other.hash), frequency(other.frequency), occurrences(other.occurrences) {}
-    const uint hash;
+    Record(const uint64_t key = 0)
+        : key(key), frequency(0), firstOccurrence(0), numOccurrences(0), prev(NULL), next(NULL), queued(false) {}
+    const uint64_t key;
     uint frequency;
-    std::vector<Pair> occurrences;
+    uint firstOccurrence, numOccurrences;
+    /// neighbours in the PriorityQueue's bucket list
+    Record<Pair> *prev, *next;
+    /// whether the record is in the PriorityQueue
+    bool queued;
 
     friend std::ostream &operator<<(std::ostream &os, const Record<Pair> &record) {
-        return os << "(" << record.frequency << "<" << record.occurrences.size() << "x" << record.hash << ")";
+        return os << "(" << record.frequency << "<" << record.numOccurrences << "x" << record.key << ")";
     }
 };
 
-/// A list of RePair records
+/// A list of RePair records and their occurrences
+/**
+ * The occurrences of all records are stored in one array, grouped by record.
+ * Once the records' frequencies are known, allocateOccurrences() assigns each
+ * record its range of the array (a counting sort), which addOccurrence() fills.
+ * clear() resets everything in place, so the memory is reused when the
+ * records are built again.
+ */
 template <typename Pair>
 struct Records {
-    Records() : records() { add(0); /* dummy for unordered_map stuff */ }
+    Records() : records(), occurrences() { clear(); }
+
+    /// Remove all records and occurrences, keeping the memory
+    void clear() {
+        records.clear();
+        occurrences.clear();
+        add(0); // dummy record, which PairCounter::find() returns for unknown keys
+    }
 
-    int add(uint hash) {
-        records.emplace_back(Record<Pair>(hash));
+    int add(const uint64_t key) {
+        records.emplace_back(key);
         return records.size()-1;
     }
 
+    /// Reserve space for `frequency` occurrences of each record
+    void allocateOccurrences() {
+        uint offset(0);
+        for (Record<Pair> &record : records) {
+            record.firstOccurrence = offset;
+            offset += record.frequency;
+            record.numOccurrences = 0;
+        }
+        occurrences.resize(offset);
+    }
+
+    /// Add the next occurrence of a record, after allocateOccurrences()
+    void addOccurrence(Record<Pair> &record, const Pair &pair) {
+        assert(record.numOccurrences < record.frequency);
+        occurrences[record.firstOccurrence + record.numOccurrences++] = pair;
+    }
+
+    /// The highest frequency of any record
+    uint maxFrequency() const {
+        uint result(0);
+        for (const Record<Pair> &record : records) {
+            result = std::max(result, record.frequency);
+        }
+        return result;
+    }
+
+    /// The first occurrence of a record
+    const Pair *beginOccurrences(const Record<Pair> &record) const {
+        return occurrences.data() + record.firstOccurrence;
+    }
+
+    /// Behind the last occurrence of a record
+    const Pair *endOccurrences(const Record<Pair> &record) const {
+        return occurrences.data() + record.firstOccurrence + record.numOccurrences;
+    }
+
     Record<Pair>& operator[](typename std::vector<Record<Pair>>::size_type index) {
         return records[index];
     }
 
-    const Pair& operator[](typename std::vector<Record<Pair>>::size_type index) const {
+    const Record<Pair>& operator[](typename std::vector<Record<Pair>>::size_type index) const {
         return records[index];
     }
 
     std::vector<Record<Pair>> records;
-};
-
-/// Compare RePair records by frequency (>)
-template <typename Pair>
-struct RecordFrequencyComparator {
-    bool operator()(const Record<Pair> *record, const Record<Pair> *other) const {
-        return record->frequency > other->frequency;
-    }
+    /// the occurrences of all records, grouped by record
+    std::vector<Pair> occurrences;
 };
 
 /// Specialised bucket priority queue for RePair
+/**
+ * There is one bucket per frequency, a doubly linked list threaded through the
+ * records (see Record::prev and Record::next), so inserting, decrementing a
+ * frequency and popping the most frequent record take constant time (popping
+ * amortised, as the highest non-empty bucket only moves down). Records are
+ * taken from the front of their bucket, so the most recently inserted record
+ * of the highest frequency is popped first.
+ */
 template <typename Pair>
 struct PriorityQueue {
-    PriorityQueue(const int size = 0) : lastNonEmptyList(-1), lists(size), frequentRecords() {}
+    PriorityQueue() : lastNonEmptyList(-1), lists() {}
 
-    void init(const int size) {
-        lists.resize(size);
+    /// Remove all records and prepare for frequencies up to maxFrequency
+    void init(const uint maxFrequency) {
+        lists.assign(maxFrequency >= 2 ? maxFrequency - 1 : 0, NULL);
+        lastNonEmptyList = -1;
     }
 
     void insert(Record<Pair>* record) {
-        assert(record->frequency >= 2);
+        assert(record->frequency >= 2 && !record->queued);
         const uint bucket = record->frequency - 2;
-        if (bucket < lists.size()) {
-            lastNonEmptyList = std::max(lastNonEmptyList, (int)bucket);
-            lists[bucket].insert(record);
-        } else {
-            lastNonEmptyList = lists.size();
-            frequentRecords.insert(record);
-        }
+        assert(bucket < lists.size());
+        link(record, bucket);
+        lastNonEmptyList = std::max(lastNonEmptyList, (int)bucket);
     }
 
     bool empty() const {
@@ -96,128 +165,269 @@ struct PriorityQueue {
     }
 
     Record<Pair> *popMostFrequentRecord() {
-        Record<Pair> *result;
         assert(lastNonEmptyList >= 0);
-        if (lastNonEmptyList == (int)lists.size()) {
-            assert(!frequentRecords.empty());
-            result = *frequentRecords.begin();
-            frequentRecords.erase(frequentRecords.begin());
-            if (frequentRecords.empty()) {
-                lastNonEmptyList--;
-            }
-        } else {
-            auto &list = lists[lastNonEmptyList];
-            assert(!list.empty());
-            result = *list.begin();
-            list.erase(list.begin());
-        }
+        Record<Pair> *result = lists[lastNonEmptyList];
+        assert(result != NULL);
+        unlink(result, lastNonEmptyList);
 
         findNextNonEmptyList();
 
         return result;
     }
 
+    /// Decrement the frequency of a record in the queue. Records that are not
+    /// in the queue (any more) are left alone.
     void decrementFrequency(Record<Pair> *record) {
-        assert(lastNonEmptyList >= 0);
+        if (!record->queued) {
+            return;
+        }
         const uint bucket(record->frequency - 2);
-        if (bucket < lists.size()) {
-            lists[bucket].erase(record);
-            record->frequency--;
-            if (bucket > 0) {
-                lists[bucket - 1].insert(record);
-            }
-        } else {
-            if (frequentRecords.erase(record) == 0) {
-                // Record wasn't there
-                return;
-            }
-            record->frequency--;
-            if (record->frequency < lists.size()) {
-                if (record->frequency >= 2) {
-                    lists[record->frequency - 2].insert(record);
-                }
-                if (frequentRecords.empty()) {
-                    lastNonEmptyList--;
-                }
-            } else {
-                frequentRecords.insert(record);
-            }
+        unlink(record, bucket);
+        record->frequency--;
+        if (bucket > 0) {
+            link(record, bucket - 1);
         }
 
         findNextNonEmptyList();
     }
 
     friend std::ostream &operator<<(std::ostream &os, const PriorityQueue<Pair> &queue) {
-        os << "PriorityQueue with " << queue.lists.size() << " + 1 buckets, lastNonEmptyList = " << queue.lastNonEmptyList << std::endl;
-        for (auto &list : queue.lists) {
-            os << "List " << (&list - queue.lists.data()) << ":";
-            for (Record<Pair> *record : list) {
+        os << "PriorityQueue with " << queue.lists.size() << " buckets, lastNonEmptyList = " << queue.lastNonEmptyList << std::endl;
+        for (uint bucket = 0; bucket < queue.lists.size(); ++bucket) {
+            os << "List " << bucket << ":";
+            for (const Record<Pair> *record = queue.lists[bucket]; record != NULL; record = record->next) {
                 os << " " << *record;
             }
             os << std::endl;
         }
-        os << "Frequent records list:";
-        for (Record<Pair> *record : queue.frequentRecords) {
-            os << " " << *record;
-        }
-        return os << std::endl;
+        return os;
     }
 
 private:
-    void findNextNonEmptyList() {
-        if (lastNonEmptyList == (int) lists.size()) {
-            assert(!frequentRecords.empty());
-            return;
+    /// Insert a record at the front of a bucket
+    void link(Record<Pair> *record, const uint bucket) {
+        record->prev = NULL;
+        record->next = lists[bucket];
+        if (record->next != NULL) {
+            record->next->prev = record;
+        }
+        lists[bucket] = record;
+        record->queued = true;
+    }
+
+    /// Remove a record from its bucket
+    void unlink(Record<Pair> *record, const uint bucket) {
+        if (record->prev != NULL) {
+            record->prev->next = record->next;
+        } else {
+            assert(lists[bucket] == record);
+            lists[bucket] = record->next;
+        }
+        if (record->next != NULL) {
+            record->next->prev = record->prev;
         }
-        while(lastNonEmptyList >= 0 && lists[lastNonEmptyList].empty()) {
+        record->prev = record->next = NULL;
+        record->queued = false;
+    }
+
+    void findNextNonEmptyList() {
+        while(lastNonEmptyList >= 0 && lists[lastNonEmptyList] == NULL) {
             lastNonEmptyList--;
         }
-        assert(lastNonEmptyList == -1 || !lists[lastNonEmptyList].empty());
     }
 
     int lastNonEmptyList;
-    std::vector<std::unordered_set<Record<Pair>*>> lists;
-    std::set<Record<Pair>*, RecordFrequencyComparator<Pair>> frequentRecords;
+    /// the first record of each bucket, bucket i holds the records of frequency i + 2
+    std::vector<Record<Pair>*> lists;
 };
 
-/// Specialised hash map for RePair
+/// Group pair occurrences found by several threads into Records, and find records by their keys
+/**
+ * Every thread finds the pairs of a contiguous part of the input, in input
+ * order, through its own Sink, which splits them into partitions by key. The
+ * partitions are then grouped into records in parallel, each one with its own
+ * open-addressed table. Finally, the records are numbered in the order of
+ * their first occurrences, and their occurrences are stored in input order.
+ * Thus, the records and their occurrences are exactly the same as if all
+ * pairs had been added one by one in input order, no matter how many threads
+ * were used. The partitions' tables map keys to records until the next round.
+ *
+ * All buffers are kept between rounds.
+ */
 template <typename Pair>
-struct HashMap {
-    HashMap(Records<Pair> &records) : records(records) {}
+class PairCounter {
+    /// A pair occurrence found by a thread
+    struct FoundPair {
+        FoundPair(const uint64_t key, const uint position, const Pair &pair)
+            : key(key), position(position), pair(pair) {}
+        uint64_t key;
+        /// number of pairs the thread found before this one
+        uint position;
+        Pair pair;
+    };
 
-    void add(uint hash, const Pair &pair) {
-        uint &index = recordMap[hash];
-        if (index == 0) {
-            index = records.add(hash);
+    /// A record within a partition
+    struct PartitionRecord {
+        PartitionRecord(const uint64_t key, const uint thread, const uint position)
+            : key(key), thread(thread), position(position), frequency(0), index(0) {}
+        uint64_t key;
+        /// where the record first occurred
+        uint thread, position;
+        uint frequency;
+        /// the record's index in the Records
+        int index;
+    };
+
+    struct Partition {
+        Partition() : slotBits(0), slots(), records(), recordIds() {}
+        uint slotBits;
+        /// open-addressed table of the partition's records (ID + 1, 0 for empty slots), 2^slotBits slots
+        std::vector<uint> slots;
+        std::vector<PartitionRecord> records;
+        /// the record of each pair in the partition, in the order of the pairs
+        std::vector<uint> recordIds;
+    };
+
+public:
+    /// Adds the pairs found by one thread
+    class Sink {
+    public:
+        /// Add the next pair, in input order
+        void add(const uint64_t key, const Pair &pair) {
+            lists[PairKey::mix(key) % numPartitions].emplace_back(key, position++, pair);
+        }
+
+    protected:
+        friend class PairCounter;
+        Sink(std::vector<FoundPair> *lists, const uint numPartitions)
+            : lists(lists), numPartitions(numPartitions), position(0) {}
+        std::vector<FoundPair> *lists;
+        const uint numPartitions;
+        uint position;
+    };
+
+    PairCounter() : numThreads(0), found(), partitions() {}
+
+    /// Remove all pairs and prepare for a number of threads (and as many partitions)
+    void reset(const uint threads) {
+        numThreads = threads;
+        found.resize(numThreads * numThreads);
+        for (std::vector<FoundPair> &list : found) {
+            list.clear();
         }
-        assert(index != 0);
-        records[index].frequency++;
-        records[index].occurrences.push_back(pair);
+        partitions.resize(numThreads);
+    }
+
+    /// The sink for the thread handling the `thread`-th part of the input (not thread-safe)
+    Sink getSink(const uint thread) {
+        assert(thread < numThreads);
+        return Sink(found.data() + thread * numThreads, numThreads);
     }
 
-    void populatePQ(PriorityQueue<Pair> &queue) {
-        for (auto it = recordMap.begin(); it != recordMap.end(); ++it) {
-            if (it->second != 0 && records[it->second].frequency >= 2) {
-                queue.insert(&records[it->second]);
+    /// Group the pairs added to all sinks into records of empty (cleared) Records
+    void group(Records<Pair> &records) {
+        std::vector<std::function<void (void)>> tasks;
+        for (uint partition = 0; partition < numThreads; ++partition) {
+            tasks.push_back([this, partition]() { countPartition(partition); });
+        }
+        runInParallel(tasks);
+
+        // number the records in the order of their first occurrences
+        std::vector<std::pair<uint64_t, PartitionRecord *>> order;
+        for (Partition &partition : partitions) {
+            for (PartitionRecord &record : partition.records) {
+                order.emplace_back(((uint64_t)record.thread << 32) | record.position, &record);
             }
         }
+        std::sort(order.begin(), order.end(),
+                  [](const std::pair<uint64_t, PartitionRecord *> &a, const std::pair<uint64_t, PartitionRecord *> &b) {
+                      return a.first < b.first;
+                  });
+        for (const auto &entry : order) {
+            PartitionRecord &record = *entry.second;
+            record.index = records.add(record.key);
+            records[record.index].frequency = record.frequency;
+        }
+        records.allocateOccurrences();
+
+        // every record belongs to one partition, so the partitions can store their occurrences in parallel
+        tasks.clear();
+        for (uint partition = 0; partition < numThreads; ++partition) {
+            tasks.push_back([this, partition, &records]() { storeOccurrences(partition, records); });
+        }
+        runInParallel(tasks);
+    }
+
+    /// The index of the record of a key in the Records of the last group(), or 0 (the dummy record)
+    /// if the key didn't occur
+    int find(const uint64_t key) const {
+        const Partition &partition = partitions[PairKey::mix(key) % numThreads];
+        for (size_t slot = home(key, partition); partition.slots[slot] != 0; slot = (slot + 1) & (partition.slots.size() - 1)) {
+            const PartitionRecord &record = partition.records[partition.slots[slot] - 1];
+            if (record.key == key) {
+                return record.index;
+            }
+        }
+        return 0;
     }
 
-    friend std::ostream &operator<<(std::ostream &os, const HashMap<Pair> &hashMap) {
-        os << "HashMap with " << hashMap.recordMap.size() << " different hashes" << std::endl;
-        for (auto elem : hashMap.recordMap) {
-            os << "Hash " << elem.first << " record " << hashMap.records[elem.second] << std::endl;
+protected:
+    /// The slot of a partition's table where probing for a key starts. All keys of a partition
+    /// have the same remainder of their scrambled value modulo the number of partitions, so this
+    /// uses its high bits.
+    static size_t home(const uint64_t key, const Partition &partition) {
+        return PairKey::mix(key) >> (64 - partition.slotBits);
+    }
+
+    /// Find the records of a partition and count their occurrences
+    void countPartition(const uint partitionId) {
+        Partition &partition = partitions[partitionId];
+        partition.records.clear();
+        partition.recordIds.clear();
+        size_t numPairs(0);
+        for (uint thread = 0; thread < numThreads; ++thread) {
+            numPairs += found[thread * numThreads + partitionId].size();
         }
-        os << "Records:";
-        for (Record<Pair> &record : hashMap.records.records) {
-            os << "  " << record;
+        partition.slotBits = 4;
+        while (((size_t)1 << partition.slotBits) < 2 * numPairs) {
+            ++partition.slotBits;
+        }
+        const size_t numSlots = (size_t)1 << partition.slotBits;
+        partition.slots.assign(numSlots, 0);
+
+        for (uint thread = 0; thread < numThreads; ++thread) {
+            for (const FoundPair &pair : found[thread * numThreads + partitionId]) {
+                // linear probing
+                size_t slot = home(pair.key, partition);
+                while (partition.slots[slot] != 0 && partition.records[partition.slots[slot] - 1].key != pair.key) {
+                    slot = (slot + 1) & (numSlots - 1);
+                }
+                if (partition.slots[slot] == 0) {
+                    partition.records.emplace_back(pair.key, thread, pair.position);
+                    partition.slots[slot] = partition.records.size();
+                }
+                const uint recordId = partition.slots[slot] - 1;
+                partition.records[recordId].frequency++;
+                partition.recordIds.push_back(recordId);
+            }
+        }
+    }
+
+    /// Store the occurrences of a partition's records, in input order
+    void storeOccurrences(const uint partitionId, Records<Pair> &records) {
+        Partition &partition = partitions[partitionId];
+        size_t i(0);
+        for (uint thread = 0; thread < numThreads; ++thread) {
+            for (const FoundPair &pair : found[thread * numThreads + partitionId]) {
+                records.addOccurrence(records[partition.records[partition.recordIds[i++]].index], pair.pair);
+            }
         }
-        os << std::endl;
-        return os;
     }
 
-    std::unordered_map<uint, uint> recordMap;
-    Records<Pair> &records;
+    uint numThreads;
+    /// the pairs found by each thread, split into partitions (thread-major)
+    std::vector<std::vector<FoundPair>> found;
+    std::vector<Partition> partitions;
 };
 
-}
\ No newline at end of file
+}
@@ -1,14 +1,19 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <iomanip>
+#include <thread>
 #include <vector>
 
 #include "Timer.h"
 #include "TopDag.h"
 #include "Statistics.h"
 
+#include "Parallel.h"
 #include "RePair.h"
 #include "RePairTreeHasher.h"
 
@@ -22,6 +27,14 @@ using std::vector;
  * Given a tree (currently, only OrderedTree is supported), construct
  * its top tree iteratively.
  *
+ * Every cluster is merged at most once per iteration, so the top tree's
+ * height is at most the number of iterations plus two. RePair merges do
+ * not guarantee that every iteration reduces the number of edges by a
+ * constant factor, though. In bounded-height mode, every iteration that
+ * falls short of the minimum edge ratio is followed by an iteration of
+ * plain pairwise merges only, which bounds the top tree's height by
+ * O(log n) at a small cost in compression.
+ *
  * The original tree will be modified heavily in the process!
  * When transformation is complete, only one edge will remain
  * and nodes' parent values will be lost as well.
@@ -33,7 +46,7 @@ class RePairCombiner {
     typedef typename TreeType::edgeType EdgeType;
 
     struct Pair {
-        Pair(int parentId, int leftEdgeIndex) : parentId(parentId), leftEdgeIndex(leftEdgeIndex) {}
+        Pair(int parentId = -1, int leftEdgeIndex = -1) : parentId(parentId), leftEdgeIndex(leftEdgeIndex) {}
         int parentId, leftEdgeIndex;
 
         friend std::ostream &operator<<(std::ostream &os, const Pair &pair) {
@@ -48,7 +61,8 @@ public:
     /// \param verbose whether to print detailed information about the iterations
     /// \param extraVerbose whether to print the tree in each iteration
     RePairCombiner(TreeType &tree, TopDag<DataType> &topDag, const bool verbose = true, const bool extraVerbose = false)
-        : tree(tree), topDag(topDag), verbose(verbose), extraVerbose(extraVerbose), nodeIds(tree._numNodes), hasher(tree, topDag, nodeIds) {
+        : tree(tree), topDag(topDag), verbose(verbose), extraVerbose(extraVerbose), nodeIds(tree._numNodes), hasher(tree, topDag, nodeIds),
+          records(), queue(), pairCounter() {
             for (int i = 0; i < tree._numNodes; ++i) {
                 nodeIds[i] = i;
             }
@@ -56,8 +70,11 @@ public:
 
     /// Perform the top tree construction procedure
     /// \param debugInfo pointer to a DebugInfo object, should you wish logging of debug information
-    void construct(DebugInfo *debugInfo = NULL, const double minRatio = 1.2) {
-        doMerges(debugInfo, minRatio);
+    /// \param minRatio minimum ratio of edges before and after the RePair merges of an iteration,
+    /// below which the remaining pairs are merged normally
+    /// \param boundedHeight whether to guarantee a top tree height of O(log n) (see class description)
+    void construct(DebugInfo *debugInfo = NULL, const double minRatio = 1.2, const bool boundedHeight = false) {
+        doMerges(debugInfo, minRatio, boundedHeight);
     }
 
 protected:
@@ -74,9 +91,13 @@ protected:
     /// \param debugInfo the DebugInfo object or NULL
     /// \param verbose whether to print detailed information about the iterations
     /// \param extraVerbose whether to print the tree in each iteration
-    void doMerges(DebugInfo *debugInfo, const double minRatio = 1.2) {
+    /// \param minRatio minimum edge ratio of the RePair merges, see construct()
+    /// \param boundedHeight whether to guarantee logarithmic top tree height, see construct()
+    void doMerges(DebugInfo *debugInfo, const double minRatio = 1.2, const bool boundedHeight = false) {
 
         int iteration = 0;
+        // whether to skip RePair merges in this iteration (bounded-height mode only)
+        bool plainIteration = false;
         Timer timer;
 
         hasher.hashTree();
@@ -91,10 +112,14 @@ protected:
             dirty.assign(tree._numNodes, false);
 
             const int oldNumEdges = tree._numEdges;
-            // First, do RePair merges, then whatever else is possible
-            horizontalMergesRePair(iteration);
-            if ((1.0 * oldNumEdges) / tree._numEdges < minRatio) {
+            if (plainIteration) {
                 normalHorizontalMerges(iteration);
+            } else {
+                // First, do RePair merges, then whatever else is possible
+                horizontalMergesRePair(iteration);
+                if ((1.0 * oldNumEdges) / tree._numEdges < minRatio) {
+                    normalHorizontalMerges(iteration);
+                }
             }
             tree.killNodes();
             if (verbose) cout << std::setw(6) << timer.getAndReset() << "ms; gc… " << flush;
@@ -109,8 +134,12 @@ protected:
             if (verbose) cout << std::setw(6) << timer.getAndReset() << " ms; " << tree.summary();
 
             double ratio = (oldNumEdges * 1.0) / tree._numEdges;
+            if (verbose && plainIteration) cout << " (plain merges only)";
             if (verbose) cout << std::endl;
 
+            // Too little progress in this iteration, do a plain iteration next to bound the height
+            plainIteration = boundedHeight && ratio < minRatio;
+
             if (debugInfo != NULL)
                 debugInfo->addEdgeRatio(ratio);
             iteration++;
@@ -124,43 +153,56 @@ protected:
     }
 
 
-    uint getRePairHash(const EdgeType *edge) const {
-        const uint leftHash(tree.nodes[ edge   ->headNode].hash),
-                  rightHash(tree.nodes[(edge+1)->headNode].hash);
-        return SimpleRePair::HashCombiner::hash(leftHash, rightHash);
+    /// The key of the pair of an edge's head node and its right sibling
+    uint64_t getRePairKey(const EdgeType *edge) const {
+        return SimpleRePair::PairKey::make(tree.nodes[edge->headNode].dagId, tree.nodes[(edge+1)->headNode].dagId);
     }
 
-    void prepareRePair(SimpleRePair::HashMap<Pair> &hashMap, SimpleRePair::PriorityQueue<Pair> &queue) {
-        // Populate the HashMap with the pairs
-        uint numPairs(0);
-        for (int nodeId = 0; nodeId < tree._numNodes; ++nodeId) {
-            for (int edgeId = tree.nodes[nodeId].firstEdgeIndex, stop = tree.nodes[nodeId].lastEdgeIndex; edgeId < stop; ++edgeId) {
-                EdgeType *edge = tree.edges.data() + edgeId;
-                assert(edge->valid && (edge+1)->valid);
-                if (tree.nodes[edge->headNode].isLeaf() || tree.nodes[(edge+1)->headNode].isLeaf()) {
-                    // We're only interested in merging if one is a leaf
-                    Pair pair(nodeId, edgeId);
-                    hashMap.add(getRePairHash(edge), pair);
-                    ++numPairs;
+    void prepareRePair() {
+        // Find the pairs in parallel, each thread in a contiguous range of nodes
+        const uint numThreads = std::max<int>(1, std::min<int>(std::thread::hardware_concurrency(),
+                                                               tree._numNodes / minNodesPerThread));
+        pairCounter.reset(numThreads);
+        std::vector<std::function<void (void)>> tasks;
+        for (uint thread = 0; thread < numThreads; ++thread) {
+            tasks.push_back([this, thread, numThreads]() {
+                typename SimpleRePair::PairCounter<Pair>::Sink sink = pairCounter.getSink(thread);
+                const int firstNode = (long long)tree._numNodes * thread / numThreads;
+                const int lastNode = (long long)tree._numNodes * (thread + 1) / numThreads;
+                for (int nodeId = firstNode; nodeId < lastNode; ++nodeId) {
+                    for (int edgeId = tree.nodes[nodeId].firstEdgeIndex, stop = tree.nodes[nodeId].lastEdgeIndex; edgeId < stop; ++edgeId) {
+                        const EdgeType *edge = tree.edges.data() + edgeId;
+                        assert(edge->valid && (edge+1)->valid);
+                        if (tree.nodes[edge->headNode].isLeaf() || tree.nodes[(edge+1)->headNode].isLeaf()) {
+                            // We're only interested in merging if one is a leaf
+                            sink.add(getRePairKey(edge), Pair(nodeId, edgeId));
+                        }
+                    }
                 }
+            });
+        }
+        runInParallel(tasks);
+        pairCounter.group(records);
+
+        // the records are numbered in the order of their first occurrences
+        queue.init(records.maxFrequency());
+        for (SimpleRePair::Record<Pair> &record : records.records) {
+            if (record.frequency >= 2) {
+                queue.insert(&record);
             }
         }
-
-        const int queueSize(sqrt(numPairs));
-        queue.init(queueSize);
-        hashMap.populatePQ(queue);
     }
 
     void horizontalMergesRePair(const int iteration) {
-        SimpleRePair::Records<Pair> records;
-        SimpleRePair::HashMap<Pair> hashMap(records);
-        SimpleRePair::PriorityQueue<Pair> queue;
-        prepareRePair(hashMap, queue);
+        // the records' memory is reused in every iteration
+        records.clear();
+        prepareRePair();
 
         while (!queue.empty()) {
             SimpleRePair::Record<Pair> *record = queue.popMostFrequentRecord();
             //cout << "Processing record " << *record << endl;
-            for (Pair pair : record->occurrences) {
+            for (const Pair *it = records.beginOccurrences(*record); it != records.endOccurrences(*record); ++it) {
+                const Pair &pair = *it;
                 //cout << "\tProcessing pair (" << pair.leftEdgeIndex << ", " << pair.parentId << ")" << endl;
                 const int leftEdge = pair.leftEdgeIndex;
                 const int rightEdge = leftEdge + 1;
@@ -176,16 +218,16 @@ protected:
                 // Decrement frequencies of neighbouring pairs
                 if (leftEdge > tree.nodes[pair.parentId].firstEdgeIndex) {
                     if (tree.edges[leftEdge - 1].valid && !queue.empty()) {
-                        const uint hash = getRePairHash(&tree.edges[leftEdge - 1]);
-                        auto *rec = &records[hashMap.recordMap[hash]];
+                        const uint64_t key = getRePairKey(&tree.edges[leftEdge - 1]);
+                        auto *rec = &records[pairCounter.find(key)];
                         if (rec != record)
                             queue.decrementFrequency(rec);
                     }
                 }
                 if (rightEdge < tree.nodes[pair.parentId].lastEdgeIndex) {
                     if (tree.edges[rightEdge + 1].valid && !queue.empty()) {
-                        const uint hash = getRePairHash(&tree.edges[rightEdge]);
-                        auto *rec = &records[hashMap.recordMap[hash]];
+                        const uint64_t key = getRePairKey(&tree.edges[rightEdge]);
+                        auto *rec = &records[pairCounter.find(key)];
                         if (rec != record)
                             queue.decrementFrequency(rec);
                     }
@@ -307,4 +349,10 @@ protected:
     vector<int> nodeIds;
     NodeHasher<TreeType, DataType> hasher;
     vector<bool> dirty;
+    /// the pair-counting state of horizontalMergesRePair()
+    SimpleRePair::Records<Pair> records;
+    SimpleRePair::PriorityQueue<Pair> queue;
+    SimpleRePair::PairCounter<Pair> pairCounter;
+    /// prepareRePair() uses at most one thread per this many nodes
+    static const int minNodesPerThread = 1 << 16;
 };
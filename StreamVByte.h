@@ -0,0 +1,154 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+#include "BitReader.h"
+#include "BitWriter.h"
+
+/// Stream VByte coding of 32-bit integers (Lemire, Kurz and Rupp, "Stream VByte: Faster
+/// Byte-Oriented Integer Compression", 2018)
+/**
+ * Every value is stored in 1 to 4 little-endian bytes. The lengths of each group of
+ * four values are stored in a control byte (2 bits per value), and all control bytes
+ * precede all data bytes. Thus, a group can be decoded with a single shuffle
+ * instruction whose mask is looked up by the control byte (if compiled with SSSE3
+ * support, e.g., `make SIMD=-mssse3`, otherwise by a scalar loop).
+ *
+ * Within a bit stream, the coded values start at a byte boundary. Their number is
+ * not stored, the reader needs to know it.
+ */
+struct StreamVByte {
+    /// Number of bytes needed to store a value
+    static unsigned int byteLength(const uint32_t value) {
+        return 1 + (value > 0xff) + (value > 0xffff) + (value > 0xffffff);
+    }
+
+    /// Number of data bytes of a group with the given control byte
+    static unsigned int groupLength(const uint8_t control) {
+        return 4 + (control & 0x3) + ((control >> 2) & 0x3) + ((control >> 4) & 0x3) + (control >> 6);
+    }
+
+#ifdef __SSSE3__
+    /// Shuffle masks to move a group's data bytes to four 32-bit integers, by control byte
+    static const std::array<std::array<uint8_t, 16>, 256> &shuffleMasks() {
+        static const std::array<std::array<uint8_t, 16>, 256> masks = [] {
+            std::array<std::array<uint8_t, 16>, 256> result;
+            for (unsigned int control = 0; control < 256; ++control) {
+                uint8_t source(0);
+                for (unsigned int i = 0; i < 4; ++i) {
+                    const unsigned int length = ((control >> (2 * i)) & 0x3) + 1;
+                    for (unsigned int byte = 0; byte < 4; ++byte) {
+                        // 0x80 makes the shuffle write a zero byte
+                        result[control][4 * i + byte] = (byte < length) ? source++ : 0x80;
+                    }
+                }
+            }
+            return result;
+        }();
+        return masks;
+    }
+#endif
+};
+
+/// Buffers 32-bit values and writes them Stream VByte-coded, see StreamVByte
+class StreamVByteWriter {
+public:
+    StreamVByteWriter(BitWriter &writer) : writer(writer), values() {}
+
+    void addItem(const uint32_t value) {
+        values.push_back(value);
+    }
+
+    template <typename InputIterator>
+    void addItems(InputIterator begin, InputIterator end) {
+        values.insert(values.end(), begin, end);
+    }
+
+    /// Write the values (after padding the bit stream to a byte boundary) and clear the buffer
+    void writeBuffer() {
+        writer.alignToByte();
+        for (size_t group = 0; group < values.size(); group += 4) {
+            uint8_t control(0);
+            for (size_t i = group; i < group + 4 && i < values.size(); ++i) {
+                control |= (StreamVByte::byteLength(values[i]) - 1) << (2 * (i - group));
+            }
+            writer.writeBits(control, 8);
+        }
+        for (const uint32_t value : values) {
+            for (unsigned int byte = 0; byte < StreamVByte::byteLength(value); ++byte) {
+                writer.writeBits((value >> (8 * byte)) & 0xff, 8);
+            }
+        }
+        values.clear();
+    }
+
+    /// The number of bytes writeBuffer() will write (without the padding)
+    size_t getBytesNeeded() const {
+        size_t bytes = (values.size() + 3) / 4;
+        for (const uint32_t value : values) {
+            bytes += StreamVByte::byteLength(value);
+        }
+        return bytes;
+    }
+
+protected:
+    BitWriter &writer;
+    std::vector<uint32_t> values;
+};
+
+/// Decoder for values written by StreamVByteWriter
+class StreamVByteReader {
+public:
+    /// Decode `count` values and append them to `items`
+    /// \return whether the input contained enough data
+    template <typename ItemType>
+    static bool decode(BitReader &reader, const size_t count, std::vector<ItemType> &items) {
+        reader.alignToByte();
+        const size_t numControlBytes = (count + 3) / 4;
+        if (reader.bytesLeft() < numControlBytes) return false;
+        const uint8_t *control = reader.bytes();
+        const uint8_t *data = control + numControlBytes;
+        const uint8_t *const end = control + reader.bytesLeft();
+
+        const size_t begin = items.size();
+        items.resize(begin + count);
+        ItemType *out = items.data() + begin;
+        size_t decoded(0);
+#ifdef __SSSE3__
+        // whole groups for which 16 bytes can be loaded
+        const auto &masks = StreamVByte::shuffleMasks();
+        for (; decoded + 4 <= count && data + 16 <= end; decoded += 4, ++control) {
+            const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+            const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(masks[*control].data()));
+            uint32_t values[4];
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(values), _mm_shuffle_epi8(input, mask));
+            for (unsigned int i = 0; i < 4; ++i) {
+                out[decoded + i] = values[i];
+            }
+            data += StreamVByte::groupLength(*control);
+        }
+#endif
+        for (; decoded < count; ++control) {
+            for (unsigned int i = 0; i < 4 && decoded < count; ++i, ++decoded) {
+                const unsigned int length = ((*control >> (2 * i)) & 0x3) + 1;
+                if (data + length > end) return false;
+                uint32_t value(0);
+                for (unsigned int byte = 0; byte < length; ++byte) {
+                    value |= (uint32_t)data[byte] << (8 * byte);
+                }
+                out[decoded] = value;
+                data += length;
+            }
+        }
+        reader.skipBytes(data - reader.bytes());
+        return true;
+    }
+};
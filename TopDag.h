@@ -1,7 +1,9 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "Labels.h"
@@ -78,6 +80,19 @@ public:
         return maxClusterId;
     }
 
+    /// Append an inner node without checking whether it exists already (e.g., when reading
+    /// a DAG from a file) and return its node ID.
+    /// \param left node ID of the left child
+    /// \param right node ID of the right child
+    /// \param mergeType the node's merge type
+    int addNode(const int left, const int right, const MergeType mergeType) {
+        assert(0 < left && left < (int)nodes.size() && 0 < right && right < (int)nodes.size());
+        nodes.emplace_back(left, right, (DataType *)NULL, mergeType);
+        nodes[left].inDegree++;
+        nodes[right].inDegree++;
+        return nodes.size() - 1;
+    }
+
     /// Call this to clean up temporary data structures once the DAG is final
     void finishCreation() {
         nodeMap.clear();
@@ -115,6 +130,48 @@ public:
         return callback(nodeId, left, right);
     }
 
+    /// Fold the represented top tree in post order, applying a callback to the callback results
+    /// of a cluster's children. Equivalent to TopTree::foldPostOrder on the unpacked top tree,
+    /// but every DAG node is only evaluated once.
+    /// \param callback function to be called on its results of the left and right child
+    /// \param initial value to use as "callback result" for leaves
+    template <typename T, typename Callback>
+    T foldPostOrder(const Callback &callback, const T initial) const {
+        vector<T> results(nodes.size(), initial);
+        // children always have smaller IDs than their parents
+        for (uint nodeId = 1; nodeId < nodes.size(); ++nodeId) {
+            const DagNode<DataType> &node = nodes[nodeId];
+            results[nodeId] = callback(node.left >= 0 ? results[node.left] : initial,
+                                       node.right >= 0 ? results[node.right] : initial);
+        }
+        return results.back();
+    }
+
+    /// Get the height of the represented top tree (same as TopTree::height())
+    int height() const {
+        return foldPostOrder<int>([](const int leftHeight, const int rightHeight) {
+            return std::max(leftHeight, rightHeight) + 1;
+        }, 0);
+    }
+
+    /// Get the depth of the represented top tree's highest leaf (same as TopTree::minDepth())
+    int minDepth() const {
+        return foldPostOrder<int>([](const int left, const int right) {
+            return std::min(left, right) + 1;
+        }, 0);
+    }
+
+    /// Get the average depth of the represented top tree's nodes (same as TopTree::avgDepth())
+    double avgDepth() const {
+        typedef std::pair<uint_fast64_t, uint_fast64_t> P;
+        P countAndSum = foldPostOrder<P>([](const P left, const P right) {
+            const auto count = left.first + right.first + 1;
+            const auto sum = left.second + right.second + count;
+            return P(count, sum);
+        }, P(1, 0));
+        return (double)countAndSum.second / countAndSum.first;
+    }
+
     friend std::ostream &operator<<(std::ostream &os, const TopDag<DataType> &dag) {
         os << "Binary Dag with " << dag.nodes.size() - 1 << " nodes";
         for (uint i = 1; i < dag.nodes.size(); ++i) {
@@ -149,16 +206,6 @@ protected:
         return id;
     }
 
-    /// Add a node
-    /// \param left left child
-    /// \param right right child
-    /// \param label a label pointer
-    /// \param mergeType the original node's merge type (for use with a TopTree)
-    int addNode(int left, int right, MergeType mergeType, const DataType *label) {
-        nodes.emplace_back(left, right, label, mergeType);
-        return (nodes.size() - 1);
-    }
-
     /// Remove the last node
     void popNode() {
         nodes.pop_back();
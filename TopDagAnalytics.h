@@ -0,0 +1,218 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ClusterSizes.h"
+#include "Common.h"
+#include "TopDag.h"
+
+using std::vector;
+
+/// Aggregate information about a cluster, independent of where in the tree it occurs
+struct ClusterSummary {
+    ClusterSummary() : size(0), depthSum(0), maxDepth(0), boundaryDepth(0), numRoots(0) {}
+
+    /// number of tree nodes in the cluster
+    unsigned long long size;
+    /// sum of the nodes' depths, relative to the node the cluster hangs below
+    unsigned long long depthSum;
+    /// maximum relative depth of the cluster's nodes
+    uint maxDepth;
+    /// relative depth of the bottom boundary node (0 if there is none)
+    uint boundaryDepth;
+    /// number of nodes that are children of the node the cluster hangs below
+    uint numRoots;
+
+    friend std::ostream &operator<<(std::ostream &os, const ClusterSummary &summary) {
+        return os << "(n=" << summary.size << ";d=" << summary.depthSum << ";h=" << summary.maxDepth
+                  << ";b=" << summary.boundaryDepth << ";r=" << summary.numRoots << ")";
+    }
+};
+
+/// Compute aggregate statistics of the tree represented by a Top DAG without unpacking it
+/**
+ * Node counts, height and average depth are computed bottom-up from per-cluster
+ * summaries in O(|DAG|). Label and fan-out histograms additionally need the
+ * number of occurrences of each cluster in the top tree, which takes another
+ * top-down pass in O(|DAG|). The depth histogram propagates the distinct depths
+ * at which each cluster occurs, so its cost also depends on how many different
+ * depths shared clusters appear at.
+ *
+ * The DAG can also be a MappedTopDag, which is analysed in place.
+ */
+template <typename DataType, typename DAGType = TopDag<DataType>>
+class TopDagAnalytics {
+public:
+    /// Prepare analytics for a Top DAG
+    /// \param dag the Top DAG. Must be final (no more clusters added)
+    TopDagAnalytics(const DAGType &dag) : dag(dag), sizes(), summaries(), occurrences() {}
+
+    /// Compute the per-cluster summaries bottom-up
+    void computeSummaries() {
+        if (!summaries.empty()) return;
+        sizes.compute(dag);
+        summaries.resize(dag.nodes.size());
+        // in the same order as ClusterSizes::compute(), children first
+        for (uint nodeId = 1; nodeId < dag.nodes.size(); ++nodeId) {
+            const DagNode<DataType> &node = dag.nodes[nodeId];
+            ClusterSummary &summary = summaries[nodeId];
+            summary.size = sizes.size(nodeId);
+            summary.boundaryDepth = sizes.boundaryDepths[nodeId];
+            if (node.left < 0) {
+                summary.depthSum = 1;
+                summary.maxDepth = 1;
+                summary.numRoots = 1;
+                continue;
+            }
+
+            const ClusterSummary &left(summaries[node.left]), &right(summaries[node.right]);
+            switch (node.mergeType) {
+            case VERT_WITH_BBN:
+            case VERT_NO_BBN:
+                // the right cluster hangs below the left cluster's boundary node
+                summary.depthSum = left.depthSum + right.depthSum + right.size * left.boundaryDepth;
+                summary.maxDepth = std::max(left.maxDepth, left.boundaryDepth + right.maxDepth);
+                summary.numRoots = left.numRoots;
+                break;
+            case HORZ_LEFT_BBN:
+            case HORZ_RIGHT_BBN:
+            case HORZ_NO_BBN:
+                summary.depthSum = left.depthSum + right.depthSum;
+                summary.maxDepth = std::max(left.maxDepth, right.maxDepth);
+                summary.numRoots = left.numRoots + right.numRoots;
+                break;
+            default:
+                assert(false);
+            }
+        }
+    }
+
+    /// Compute how often each cluster occurs in the top tree, top-down
+    void computeOccurrences() {
+        if (!occurrences.empty()) return;
+        occurrences.assign(dag.nodes.size(), 0);
+        occurrences.back() = 1;
+        // parents always have larger IDs than their children
+        for (uint nodeId = dag.nodes.size() - 1; nodeId > 0; --nodeId) {
+            const DagNode<DataType> &node = dag.nodes[nodeId];
+            if (node.left >= 0) {
+                occurrences[node.left] += occurrences[nodeId];
+                occurrences[node.right] += occurrences[nodeId];
+            }
+        }
+    }
+
+    /// The summary of the cluster represented by a DAG node
+    const ClusterSummary &getSummary(const int nodeId) {
+        computeSummaries();
+        return summaries[nodeId];
+    }
+
+    /// The number of nodes in the tree
+    unsigned long long numNodes() {
+        return getSummary(dag.nodes.size() - 1).size;
+    }
+
+    /// The height of the tree, i.e., the maximum depth of a node, where the root has depth 1
+    /// (same as OrderedTree::height())
+    int height() {
+        return getSummary(dag.nodes.size() - 1).maxDepth;
+    }
+
+    /// The average depth of the tree's nodes, where the root has depth 1
+    /// (same as OrderedTree::avgDepth())
+    double avgDepth() {
+        const ClusterSummary &root = getSummary(dag.nodes.size() - 1);
+        return (double)root.depthSum / root.size;
+    }
+
+    /// Count the number of nodes per label
+    /// \param histogram map from label to number of nodes with that label
+    void labelHistogram(std::unordered_map<DataType, unsigned long long> &histogram) {
+        computeOccurrences();
+        histogram.clear();
+        for (uint nodeId = 1; nodeId < dag.nodes.size(); ++nodeId) {
+            const DagNode<DataType> &node = dag.nodes[nodeId];
+            if (node.left < 0) {
+                histogram[*node.label] += occurrences[nodeId];
+            }
+        }
+    }
+
+    /// Count the number of nodes per number of children
+    /// \param histogram map from number of children to number of nodes with that many children
+    void fanOutHistogram(std::map<uint, unsigned long long> &histogram) {
+        computeSummaries();
+        computeOccurrences();
+        histogram.clear();
+        unsigned long long innerNodes(0);
+        for (uint nodeId = 1; nodeId < dag.nodes.size(); ++nodeId) {
+            const DagNode<DataType> &node = dag.nodes[nodeId];
+            // The children of every inner node form the right cluster of exactly one vertical merge
+            if (node.mergeType == VERT_WITH_BBN || node.mergeType == VERT_NO_BBN) {
+                histogram[summaries[node.right].numRoots] += occurrences[nodeId];
+                innerNodes += occurrences[nodeId];
+            }
+        }
+        const unsigned long long leaves = numNodes() - innerNodes;
+        if (leaves > 0) {
+            histogram[0] += leaves;
+        }
+    }
+
+    /// Count the number of nodes per depth (the root has depth 1)
+    /// \param histogram will hold the number of nodes at depth i in position i
+    void depthHistogram(vector<unsigned long long> &histogram) {
+        computeSummaries();
+        histogram.assign(height() + 1, 0);
+
+        // depths of the nodes that a cluster hangs below, with multiplicities
+        typedef std::pair<uint, unsigned long long> DepthCount;
+        vector<vector<DepthCount>> offsets(dag.nodes.size());
+        offsets.back().emplace_back(0, 1);
+
+        // parents always have larger IDs than their children
+        for (uint nodeId = dag.nodes.size() - 1; nodeId > 0; --nodeId) {
+            vector<DepthCount> &nodeOffsets = offsets[nodeId];
+            if (nodeOffsets.empty()) continue;
+            const DagNode<DataType> &node = dag.nodes[nodeId];
+
+            if (node.left < 0) {
+                for (const DepthCount &offset : nodeOffsets) {
+                    histogram[offset.first + 1] += offset.second;
+                }
+            } else {
+                // Consolidate the offsets received from all parents
+                std::sort(nodeOffsets.begin(), nodeOffsets.end());
+                uint last(0);
+                for (uint i = 1; i < nodeOffsets.size(); ++i) {
+                    if (nodeOffsets[i].first == nodeOffsets[last].first) {
+                        nodeOffsets[last].second += nodeOffsets[i].second;
+                    } else {
+                        nodeOffsets[++last] = nodeOffsets[i];
+                    }
+                }
+                nodeOffsets.resize(last + 1);
+
+                const bool vertical = (node.mergeType == VERT_WITH_BBN || node.mergeType == VERT_NO_BBN);
+                const uint rightShift = vertical ? summaries[node.left].boundaryDepth : 0;
+                for (const DepthCount &offset : nodeOffsets) {
+                    offsets[node.left].push_back(offset);
+                    offsets[node.right].emplace_back(offset.first + rightShift, offset.second);
+                }
+            }
+            vector<DepthCount>().swap(nodeOffsets);
+        }
+    }
+
+protected:
+    const DAGType &dag;
+    ClusterSizes sizes;
+    vector<ClusterSummary> summaries;
+    vector<unsigned long long> occurrences;
+};
@@ -19,6 +19,10 @@ using std::vector;
  * Given a tree (currently, only OrderedTree is supported), construct
  * its top tree iteratively.
  *
+ * Every cluster is merged at most once per iteration and every iteration
+ * reduces the number of edges by a constant factor, so the top tree has
+ * height O(log n).
+ *
  * The original tree will be modified heavily in the process!
  * When transformation is complete, only one edge will remain
  * and nodes' parent values will be lost as well.
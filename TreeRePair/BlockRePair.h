@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../Parallel.h"
+#include "Dictionary.h"
+#include "RePair.h"
+
+namespace RePair {
+
+/// Approximate RePair that compresses blocks of the input independently, in parallel
+/**
+ * The input is split into `numBlocks` contiguous blocks of (almost) equal
+ * length, which are RePair-ed directly from the input, without copying them.
+ * One thread per core (or per block, if there are fewer blocks) repeatedly
+ * takes the next block that is left. Afterwards, the blocks' dictionaries are
+ * merged into one: the rules of every block are renamed, in the order they
+ * were created, and rules that are equal after renaming (i.e., that derive the
+ * same string in the same way) are only kept once. The output is the
+ * concatenation of the renamed blocks' outputs.
+ *
+ * The result is a valid grammar for the whole input, but usually a larger one
+ * than global RePair finds, as pairs spanning two blocks are never replaced and
+ * rules are only shared if the blocks built them identically.
+ */
+template <typename DataType, typename InputType, bool compact = false>
+class BlockRePair {
+public:
+    BlockRePair(const std::vector<InputType> &data, const int numBlocks)
+        : data(data), numBlocks(std::max<size_t>(1, std::min<size_t>(numBlocks, data.size()))),
+          blockOutputs(), blockDictionaries(), dictionary(0), numBlockRules(0) {}
+
+    void compress(std::vector<DataType> &out) {
+        blockOutputs.assign(numBlocks, std::vector<DataType>());
+        blockDictionaries.clear();
+        blockDictionaries.resize(numBlocks);
+
+        const size_t numThreads = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), numBlocks));
+        std::atomic<size_t> nextBlock(0);
+        std::vector<std::function<void (void)>> tasks;
+        for (size_t thread = 0; thread < numThreads; ++thread) {
+            tasks.push_back([this, &nextBlock] {
+                for (size_t block; (block = nextBlock++) < numBlocks; ) {
+                    RePair<DataType, InputType, compact> repair(data.cbegin() + data.size() * block / numBlocks,
+                                                                data.cbegin() + data.size() * (block + 1) / numBlocks);
+                    repair.compress(blockOutputs[block]);
+                    blockDictionaries[block].reset(new Dictionary<DataType>(std::move(repair.getDictionary())));
+                }
+            });
+        }
+        runInParallel(tasks);
+
+        merge(out);
+    }
+
+    Dictionary<DataType>& getDictionary() {
+        return dictionary;
+    }
+
+    /// The number of blocks
+    size_t getNumBlocks() const {
+        return numBlocks;
+    }
+
+    /// The total number of rules of the blocks' dictionaries (before merging)
+    size_t getNumBlockRules() const {
+        return numBlockRules;
+    }
+
+protected:
+    /// Merge the blocks' dictionaries into `dictionary` and their outputs into `out`
+    void merge(std::vector<DataType> &out) {
+        // terminals keep their numbers, so the nonterminals start after the largest terminal of any block
+        DataType firstIndex(0);
+        for (const auto &blockDictionary : blockDictionaries) {
+            firstIndex = std::max(firstIndex, blockDictionary->getFirstIndex());
+        }
+        dictionary = Dictionary<DataType>(firstIndex);
+        numBlockRules = 0;
+
+        // the merged dictionary's rules by their right-hand side
+        std::unordered_map<uint64_t, DataType> rules;
+        std::vector<DataType> renamed;
+        for (size_t block = 0; block < blockDictionaries.size(); ++block) {
+            Dictionary<DataType> &blockDictionary = *blockDictionaries[block];
+            const DataType blockFirstIndex = blockDictionary.getFirstIndex();
+            // the new name of each of the block's nonterminals
+            renamed.clear();
+            auto rename = [&](const DataType symbol) {
+                return symbol < blockFirstIndex ? symbol : renamed[symbol - blockFirstIndex];
+            };
+
+            // a rule only refers to older ones, so renaming them in order of creation works
+            for (DataType symbol = blockFirstIndex; symbol < blockDictionary.numSymbols(); ++symbol) {
+                const std::pair<DataType, DataType> production = blockDictionary.getProduction(symbol);
+                const DataType first(rename(production.first)), second(rename(production.second));
+                const uint64_t key = ((uint64_t)(uint32_t)first << 32) | (uint32_t)second;
+                auto rule = rules.find(key);
+                if (rule == rules.end()) {
+                    rule = rules.emplace(key, dictionary.addPair(first, second)).first;
+                }
+                renamed.push_back(rule->second);
+            }
+            numBlockRules += renamed.size();
+            blockDictionaries[block].reset();
+
+            for (const DataType symbol : blockOutputs[block]) {
+                out.push_back(rename(symbol));
+            }
+            std::vector<DataType>().swap(blockOutputs[block]);
+        }
+    }
+
+    const std::vector<InputType> &data;
+    const size_t numBlocks;
+    std::vector<std::vector<DataType>> blockOutputs;
+    std::vector<std::unique_ptr<Dictionary<DataType>>> blockDictionaries;
+    Dictionary<DataType> dictionary;
+    size_t numBlockRules;
+};
+
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <vector>
 
 #include "../Common.h"
@@ -44,7 +45,13 @@ struct Coder {
 
     long long getBitsNeeded() const {
         // don't need to code the
-        return huff.getBitsNeeded() + huff.getBitsForTableLabels() + bitsForInputMapping;
+        return huff.getBitsNeeded() + huff.getBitsForTableLabels(getBitsPerSymbol()) + bitsForInputMapping;
+    }
+
+    /// The number of bits per symbol in the Huffman table: the largest symbols are the
+    /// dictionary's size and the last symbol it creates
+    int getBitsPerSymbol() const {
+        return bitsFor((unsigned long long)std::max<size_t>(dict.numSymbols(), dict.size()) + 1);
     }
 
     long long bitsForInputMapping;
@@ -9,7 +9,8 @@ namespace RePair {
 
 template <typename DataType>
 struct Dictionary {
-    Dictionary(Records<DataType> &initialContent) : nextIndex(0) {
+    template <bool compact>
+    Dictionary(Records<DataType, compact> &initialContent) : nextIndex(0), firstIndex(0) {
         const int maxIndex = (int)initialContent.text.size() - 1;
         for (int i = 1; i < maxIndex; ++i) {
             firstIndex = std::max(firstIndex, initialContent.text[i]);
@@ -18,6 +19,9 @@ struct Dictionary {
         nextIndex = firstIndex;
     }
 
+    /// An empty dictionary whose nonterminals start at firstIndex
+    explicit Dictionary(const DataType firstIndex) : nextIndex(firstIndex), firstIndex(firstIndex) {}
+
     DataType addPair(DataType first, DataType second) {
         dict[nextIndex++] = std::make_pair(first, second);
         return (nextIndex - 1);
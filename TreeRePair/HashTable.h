@@ -1,5 +1,8 @@
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
 #include <vector>
 
 #include "PQEntry.h"
@@ -8,89 +11,164 @@
 namespace RePair {
 
 /// RePair hash table using hashing with open addressing and linear probing
-template <typename DataType>
+/**
+ * The table's size is a power of two, at least four times the number of entries
+ * (it doubles when it gets fuller). Every slot stores an entry's ID together
+ * with (the upper half of) its pair's hash, which decides the slot the probing
+ * starts at. Thus the entries can be moved around without looking at the text,
+ * which is needed as removing an entry shifts the following entries of its
+ * cluster backwards instead of rehashing them.
+ */
+template <typename DataType, bool compact = false>
 class HashTable {
+    struct Slot {
+        Slot(const uint32_t hash = 0, const EntryId entry = NO_ENTRY) : hash(hash), entry(entry) {}
+        uint32_t hash;
+        EntryId entry;
+    };
+
 public:
-    HashTable(Records<DataType> &records) : freeSlots(records.symbolCount), lastHashIndex(0), table(freeSlots, nullptr), text(records) {}
+    HashTable(Records<DataType, compact> &records, const PQEntryPool &pool)
+        : numEntries(0), lastHashIndex(0), slotBits(0), table(), text(records), pool(pool), numLookups(0), numProbes(0), maxSize(0) {
+        resize(minSlotBits);
+    }
 
     /// Find a PQEntry by its index
-    PQEntry* find(const int index) {
-        const int first(text.text[index]), second(text.nextSymbol(index));
-
-        PQEntry *entry = table[lastHashIndex];
-        if (entry == nullptr || !text.occursAt(entry->index, first, second)) {
-            lastHashIndex = hashPair(first, second);
-            do {
-                lastHashIndex = (lastHashIndex + 1) % table.size();
-                entry = table[lastHashIndex];
-            } while (entry != nullptr && !text.occursAt(entry->index, first, second));
+    EntryId find(const int index) {
+        const DataType first(text.text[index]), second(text.nextSymbol(index));
+        const uint32_t hash = hashPair(first, second) >> 32;
+        ++numLookups;
+
+        const Slot &last = table[lastHashIndex];
+        if (last.entry != NO_ENTRY && last.hash == hash && text.occursAt(pool[last.entry].index, first, second)) {
+            return last.entry;
+        }
+        for (lastHashIndex = home(hash); ; lastHashIndex = (lastHashIndex + 1) & mask()) {
+            ++numProbes;
+            const Slot &slot = table[lastHashIndex];
+            if (slot.entry == NO_ENTRY ||
+                (slot.hash == hash && text.occursAt(pool[slot.entry].index, first, second))) {
+                return slot.entry;
+            }
         }
-
-        return entry;
     }
 
     /// Add a PQEntry into the hash table
-    void insert(PQEntry *entry) {
-        assert(freeSlots > 1);
-        table[lookup(entry)] = entry;
-        --freeSlots;
+    void insert(const EntryId entry) {
+        if (minSlotsPerEntry * (numEntries + 1) > table.size()) {
+            resize(slotBits + 1);
+        }
+        const int index(pool[entry].index);
+        const Slot slot(hashPair(text.text[index], text.nextSymbol(index)) >> 32, entry);
+        table[lastHashIndex = emptySlot(slot.hash)] = slot;
+        ++numEntries;
     }
 
     /// Delete a PQEntry from the hash table
-    void remove(PQEntry *entry) {
-        int index(lastHashIndex);
-        if (table[index] != entry) {
+    void remove(const EntryId entry) {
+        size_t index(lastHashIndex);
+        if (table[index].entry != entry) {
             index = lookup(entry);
         }
-        assert(table[index] == entry);
-        table[index] = nullptr;
-        ++freeSlots;
-
-        // rehash
-        while (true) {
-            index = (index + 1) % table.size();
-            entry = table[index];
-            if (entry == nullptr) {
-                break;
-            } else {
-                table[index] = nullptr;
-                table[lookup(entry)] = entry;
+        assert(table[index].entry == entry);
+        --numEntries;
+
+        // Shift the following entries of the cluster backwards if that brings them closer to their home
+        for (size_t next = (index + 1) & mask(); table[next].entry != NO_ENTRY; next = (next + 1) & mask()) {
+            if (((next - home(table[next].hash)) & mask()) >= ((next - index) & mask())) {
+                table[index] = table[next];
+                index = next;
             }
         }
+        table[index] = Slot();
     }
 
     /// Clear everything from the hash table. It  won't be reusable afterwards,
     /// this is if you no longer need it and want to reclaim the memory
     void clear() {
-        table.clear();
+        std::vector<Slot>().swap(table);
     }
 
-    /// Hash two things. Maybe not the greatest hash function in the world.
-    static DataType hashPair(const DataType a, const DataType b) {
-        DataType res = a * (a + b + 1) + b * (b + 1);
-        return (res < 0) ? -res : res;
+    /// Hash two things (a multiply-xorshift mix of both)
+    static uint64_t hashPair(const DataType a, const DataType b) {
+        uint64_t key = ((uint64_t)(uint32_t)a << 32) | (uint32_t)b;
+        key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+        return key ^ (key >> 31);
+    }
+
+    /// The number of find() calls so far
+    uint64_t getNumLookups() const {
+        return numLookups;
+    }
+
+    /// The number of slots find() looked at, apart from the slot of the previous find()
+    uint64_t getNumProbes() const {
+        return numProbes;
+    }
+
+    /// The largest number of slots the table had
+    size_t getMaxSize() const {
+        return maxSize;
     }
 
 private:
+    static const int minSlotBits = 10;
+    /// the table has at least this many slots per entry (its load factor is at most 1/4)
+    static const size_t minSlotsPerEntry = 4;
+
+    size_t mask() const {
+        return table.size() - 1;
+    }
+
+    /// The slot where probing for a hash starts
+    size_t home(const uint32_t hash) const {
+        return hash >> (32 - slotBits);
+    }
 
-    int lookup(PQEntry *entry) {
-        lastHashIndex = hashEntry(entry);
-        do {
-            lastHashIndex = (lastHashIndex + 1) % table.size();
-        } while(table[lastHashIndex] != nullptr && table[lastHashIndex] != entry);
+    /// The first empty slot from a hash's home
+    size_t emptySlot(const uint32_t hash) const {
+        size_t index = home(hash);
+        while (table[index].entry != NO_ENTRY) {
+            index = (index + 1) & mask();
+        }
+        return index;
+    }
 
+    /// The slot of an entry in the table
+    size_t lookup(const EntryId entry) {
+        const int index(pool[entry].index);
+        lastHashIndex = home(hashPair(text.text[index], text.nextSymbol(index)) >> 32);
+        while (table[lastHashIndex].entry != entry) {
+            assert(table[lastHashIndex].entry != NO_ENTRY);
+            lastHashIndex = (lastHashIndex + 1) & mask();
+        }
         return lastHashIndex;
     }
 
-    int hashEntry(PQEntry *entry) const {
-        const DataType first(text.text[entry->index]), second(text.nextSymbol(entry->index));
-        return hashPair(first, second);
+    /// Move all entries into a table of 2^bits slots
+    void resize(const int bits) {
+        assert(bits <= 32 && ((size_t)1 << bits) >= minSlotsPerEntry * numEntries);
+        std::vector<Slot> old((size_t)1 << bits);
+        old.swap(table);
+        slotBits = bits;
+        for (const Slot &slot : old) {
+            if (slot.entry != NO_ENTRY) {
+                table[emptySlot(slot.hash)] = slot;
+            }
+        }
+        lastHashIndex = 0;
+        maxSize = std::max(maxSize, table.size());
     }
 
 private:
-    int freeSlots, lastHashIndex;
-    std::vector<PQEntry*> table;
-    Records<DataType> &text;
+    size_t numEntries, lastHashIndex;
+    int slotBits;
+    std::vector<Slot> table;
+    Records<DataType, compact> &text;
+    const PQEntryPool &pool;
+    uint64_t numLookups, numProbes;
+    size_t maxSize;
 };
 
-}
\ No newline at end of file
+}
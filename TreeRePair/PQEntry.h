@@ -2,69 +2,19 @@
 
 #include <cassert>
 #include <ostream>
+#include <vector>
 
 namespace RePair {
 
-/// Represents a Priority Queue Element. These can be chained into a list.
-struct PQEntry {
-    PQEntry() : index(0), count(FLAG_MASK), nextEntry(nullptr), prevEntry(nullptr) {}
-    PQEntry(const int index, const int cnt) : index(index), count(cnt | FLAG_MASK), nextEntry(nullptr), prevEntry(nullptr) {}
-
-    /// Insert this PQEntry into a list of PQEntries
-    PQEntry* insertInto(PQEntry *list) {
-        assert(prevEntry == nullptr && nextEntry == nullptr && (list == nullptr || list->prevEntry == nullptr));
-        PQEntry *prev(nullptr), *next(list);
-
-        while (next != nullptr && getCount() < next->getCount()) {
-            prev = next;
-            next = prev->nextEntry;
-            assert(next == nullptr || next->prevEntry == prev);
-        }
-
-        if (next != nullptr) {
-            nextEntry = next;
-            next->prevEntry = this;
-        }
-        if (prev != nullptr) {
-            prevEntry = prev;
-            prev->nextEntry = this;
-            return list;
-        } else {
-            return this;
-        }
-    }
-
-    /// Insert to the front of a list of PQEntries
-    PQEntry* insertBefore(PQEntry *next) {
-        assert(prevEntry == nullptr && nextEntry == nullptr);
-        if (next != nullptr) {
-            assert(next->prevEntry == nullptr);
-            nextEntry = next;
-            next->prevEntry = this;
-        }
-        return this;
-    }
-
-    /// Remove this PQEntry from a list
-    PQEntry* removeFrom(PQEntry *first) {
-        assert(first != nullptr);
-        if (nextEntry != nullptr) {
-            assert(nextEntry->prevEntry == this);
-            nextEntry->prevEntry = prevEntry;
-        }
-        if (prevEntry != nullptr) {
-            assert(prevEntry->nextEntry == this);
-            prevEntry->nextEntry = nextEntry;
-        } else { // this was the first item
-            assert(first == this);
-            first = nextEntry;
-        }
+/// Identifies a PQEntry in its PQEntryPool
+typedef int EntryId;
+/// The ID of no entry, e.g., of an empty list's first entry
+static const EntryId NO_ENTRY = -1;
 
-        nextEntry = nullptr;
-        prevEntry = nullptr;
-
-        return first;
-    }
+/// Represents a Priority Queue Element. These can be chained into a list (see PQEntryPool).
+struct PQEntry {
+    PQEntry() : index(0), count(FLAG_MASK), nextEntry(NO_ENTRY), prevEntry(NO_ENTRY) {}
+    PQEntry(const int index, const int cnt) : index(index), count(cnt | FLAG_MASK), nextEntry(NO_ENTRY), prevEntry(NO_ENTRY) {}
 
     /// Get the number of occurrences
     int getCount() const {
@@ -91,21 +41,118 @@ struct PQEntry {
         count += delta;
     }
 
-    friend std::ostream &operator<<(std::ostream &os, const PQEntry &entry) {
-        os << "(c=" << entry.getCount() << " f=" << entry.getFlag() << " i=" << entry.index << " next=" << entry.nextEntry << " prev=" << entry.prevEntry << ")";
-        if (entry.nextEntry != nullptr) {
-            os << *entry.nextEntry;
-        }
-        return os;
-    }
-
 public:
     int index;
 protected:
+    friend class PQEntryPool;
     // flag states whether the entry is in the PQ and stored in MSB of count
     static const int FLAG_MASK = 0x40000000;
     int count;
-    PQEntry *nextEntry, *prevEntry;
+    EntryId nextEntry, prevEntry;
+};
+
+/// Storage for all PQEntries of a RePair run
+/**
+ * The entries are kept in one array and refer to each other by their index in
+ * it, so creating an entry does not allocate (except when the array grows),
+ * and the links take half the space of pointers. Released entries are reused
+ * by the following create() calls.
+ *
+ * A list of entries is given by the ID of its first entry, NO_ENTRY if it is empty.
+ * References to entries are invalidated by create().
+ */
+class PQEntryPool {
+public:
+    PQEntryPool() : entries(), freeIds() {}
+
+    /// Create a new entry, which is not in any list
+    EntryId create(const int index, const int count) {
+        if (freeIds.empty()) {
+            entries.emplace_back(index, count);
+            return entries.size() - 1;
+        }
+        const EntryId id = freeIds.back();
+        freeIds.pop_back();
+        entries[id] = PQEntry(index, count);
+        return id;
+    }
+
+    /// Release an entry that is not needed any more (and not in any list) for reuse
+    void release(const EntryId id) {
+        assert(entries[id].nextEntry == NO_ENTRY && entries[id].prevEntry == NO_ENTRY);
+        freeIds.push_back(id);
+    }
+
+    PQEntry &operator[](const EntryId id) {
+        assert(0 <= id && id < (EntryId)entries.size());
+        return entries[id];
+    }
+
+    const PQEntry &operator[](const EntryId id) const {
+        assert(0 <= id && id < (EntryId)entries.size());
+        return entries[id];
+    }
+
+    /// The number of entries that were allocated (including released ones)
+    size_t size() const {
+        return entries.size();
+    }
+
+    /// Remove all entries and free the memory
+    void clear() {
+        std::vector<PQEntry>().swap(entries);
+        std::vector<EntryId>().swap(freeIds);
+    }
+
+    /// Insert an entry at the front of a list of entries
+    /// \return the list's new first entry
+    EntryId insertBefore(const EntryId id, const EntryId next) {
+        PQEntry &entry = entries[id];
+        assert(entry.prevEntry == NO_ENTRY && entry.nextEntry == NO_ENTRY);
+        if (next != NO_ENTRY) {
+            assert(entries[next].prevEntry == NO_ENTRY);
+            entry.nextEntry = next;
+            entries[next].prevEntry = id;
+        }
+        return id;
+    }
+
+    /// Remove an entry from a list
+    /// \return the list's new first entry
+    EntryId removeFrom(const EntryId id, EntryId first) {
+        assert(first != NO_ENTRY);
+        PQEntry &entry = entries[id];
+        if (entry.nextEntry != NO_ENTRY) {
+            assert(entries[entry.nextEntry].prevEntry == id);
+            entries[entry.nextEntry].prevEntry = entry.prevEntry;
+        }
+        if (entry.prevEntry != NO_ENTRY) {
+            assert(entries[entry.prevEntry].nextEntry == id);
+            entries[entry.prevEntry].nextEntry = entry.nextEntry;
+        } else { // this was the first item
+            assert(first == id);
+            first = entry.nextEntry;
+        }
+
+        entry.nextEntry = NO_ENTRY;
+        entry.prevEntry = NO_ENTRY;
+
+        return first;
+    }
+
+    /// Print a list of entries
+    void print(std::ostream &os, EntryId list) const {
+        for (; list != NO_ENTRY; list = entries[list].nextEntry) {
+            const PQEntry &entry = entries[list];
+            os << "(c=" << entry.getCount() << " f=" << entry.getFlag() << " i=" << entry.index
+               << " id=" << list << " next=" << entry.nextEntry << " prev=" << entry.prevEntry << ")";
+        }
+    }
+
+private:
+    std::vector<PQEntry> entries;
+    /// IDs of released entries
+    std::vector<EntryId> freeIds;
 };
 
-}
\ No newline at end of file
+}
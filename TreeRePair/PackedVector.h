@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace RePair {
+
+/// A vector of non-negative integers with a fixed number of bits each
+/**
+ * The entries are stored back to back in 64-bit words, LSB first, so a vector
+ * of n entries of w bits takes n * w / 8 bytes (plus a word of padding). An
+ * entry is read or written as two consecutive words without branching, even
+ * if it lies within one of them. The width is chosen by assign(), e.g., just
+ * large enough for the positions in a text, and can be at most 64 bits. It
+ * can be increased later by widen(), e.g., when larger values come up.
+ */
+template <typename T>
+class PackedVector {
+public:
+    PackedVector() : words(), count(0), width(0) {}
+
+    /// Replace the contents by `size` entries of `bits` bits that are all `value`
+    void assign(const size_t size, const unsigned int bits, const T value = 0) {
+        assert(0 < bits && bits <= 64);
+        count = size;
+        width = bits;
+        words.assign(numWords(count, width), 0);
+        if (value != 0) {
+            for (size_t i = 0; i < count; ++i) {
+                set(i, value);
+            }
+        }
+    }
+
+    T operator[](const size_t index) const {
+        assert(index < count);
+        return (T)get(index, width);
+    }
+
+    void set(const size_t index, const T value) {
+        assert(index < count && (uint64_t)value <= mask());
+        put(index, width, value);
+    }
+
+    /// Make room for entries of `bits` bits, so that widen() needn't reallocate. The
+    /// operating system usually only provides the memory once widen() uses it.
+    void reserveBits(const unsigned int bits) {
+        words.reserve(numWords(count, bits));
+    }
+
+    /// Make the entries `bits` bits wide, keeping their values. This works in place,
+    /// from the back, as the entries only move towards it.
+    void widen(const unsigned int bits) {
+        assert(width <= bits && bits <= 64);
+        const unsigned int oldWidth = width;
+        // reserve exactly what is needed, resize() alone may double the capacity
+        words.reserve(numWords(count, bits));
+        words.resize(numWords(count, bits), 0);
+        width = bits;
+        for (size_t index = count; index-- > 0; ) {
+            put(index, width, get(index, oldWidth));
+        }
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    /// The number of bits per entry
+    unsigned int bits() const {
+        return width;
+    }
+
+    /// The largest value an entry can hold
+    T maxValue() const {
+        return (T)mask();
+    }
+
+    /// Remove all entries and free the memory
+    void clear() {
+        std::vector<uint64_t>().swap(words);
+        count = 0;
+    }
+
+private:
+    /// The lowest `width` bits set (computed rather than stored, as a stored mask
+    /// would have to be reloaded after every write to the words)
+    uint64_t mask() const {
+        return ~0ull >> (64 - width);
+    }
+
+    /// The number of words for `size` entries of `bits` bits, plus a word of padding
+    static size_t numWords(const size_t size, const unsigned int bits) {
+        return (size * bits + 63) / 64 + 1;
+    }
+
+    /// The entry at `index` if the entries are `bits` bits wide
+    uint64_t get(const size_t index, const unsigned int bits) const {
+        const size_t bit = index * bits;
+        const uint64_t *word = words.data() + bit / 64;
+        const unsigned int offset = bit % 64;
+        // the second word's bits are shifted out completely if the entry lies within the first
+        return ((word[0] >> offset) | ((word[1] << 1) << (63 - offset))) & (~0ull >> (64 - bits));
+    }
+
+    /// Set the entry at `index` if the entries are `bits` bits wide
+    void put(const size_t index, const unsigned int bits, const uint64_t value) {
+        const size_t bit = index * bits;
+        uint64_t *word = words.data() + bit / 64;
+        const unsigned int offset = bit % 64;
+        const uint64_t mask = ~0ull >> (64 - bits);
+        word[0] = (word[0] & ~(mask << offset)) | (value << offset);
+        word[1] = (word[1] & ~((mask >> 1) >> (63 - offset))) | ((value >> 1) >> (63 - offset));
+    }
+
+    std::vector<uint64_t> words;
+    size_t count;
+    unsigned int width;
+};
+
+/// A vector with the same interface as PackedVector, but a full T per entry
+/**
+ * This takes more memory than a PackedVector, but is much faster to access.
+ */
+template <typename T>
+class UnpackedVector {
+public:
+    UnpackedVector() : entries() {}
+
+    /// Replace the contents by `size` entries that are all `value` (`bits` is ignored)
+    void assign(const size_t size, const unsigned int, const T value = 0) {
+        entries.assign(size, value);
+    }
+
+    T operator[](const size_t index) const {
+        return entries[index];
+    }
+
+    void set(const size_t index, const T value) {
+        entries[index] = value;
+    }
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    /// The number of bits per entry
+    unsigned int bits() const {
+        return 8 * sizeof(T);
+    }
+
+    /// Entries always have all of T's bits, so there is nothing to reserve
+    void reserveBits(const unsigned int) {}
+
+    /// Entries always have all of T's bits, so they cannot be widened
+    void widen(const unsigned int bits) {
+        assert(bits <= this->bits());
+        (void) bits;
+    }
+
+    /// The largest value an entry can hold
+    T maxValue() const {
+        return std::numeric_limits<T>::max();
+    }
+
+    /// Remove all entries and free the memory
+    void clear() {
+        std::vector<T>().swap(entries);
+    }
+
+private:
+    std::vector<T> entries;
+};
+
+}
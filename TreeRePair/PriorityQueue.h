@@ -1,82 +1,221 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <vector>
 
 #include "PQEntry.h"
 
 namespace RePair {
 
+/// Indexed binary max-heap of PQEntries
+/**
+ * Entries are ordered by count and, among equal counts, newest first. Every
+ * entry's position in the heap is kept (by EntryId), so that any entry can be
+ * removed in O(log k) time for k entries in the heap.
+ */
+class EntryHeap {
+    struct Node {
+        Node(const int count, const uint64_t insertion, const EntryId entry) : count(count), insertion(insertion), entry(entry) {}
+        int count;
+        /// the number of entries pushed before this one
+        uint64_t insertion;
+        EntryId entry;
+    };
+
+public:
+    EntryHeap() : heap(), positions(), numInsertions(0) {}
+
+    bool empty() const {
+        return heap.empty();
+    }
+
+    size_t size() const {
+        return heap.size();
+    }
+
+    void clear() {
+        std::vector<Node>().swap(heap);
+        std::vector<int>().swap(positions);
+    }
+
+    /// Add an entry, whose count must not change while it is in the heap
+    void push(const EntryId entry, const int count) {
+        assert(entry != NO_ENTRY);
+        if (entry >= (EntryId)positions.size()) {
+            positions.resize(std::max<size_t>(entry + 1, 2 * positions.size()), -1);
+        }
+        assert(positions[entry] < 0);
+        heap.emplace_back(count, numInsertions++, entry);
+        positions[entry] = heap.size() - 1;
+        siftUp(heap.size() - 1);
+    }
+
+    /// Remove an entry that is in the heap
+    void remove(const EntryId entry) {
+        assert(entry < (EntryId)positions.size() && positions[entry] >= 0);
+        const size_t position = positions[entry];
+        positions[entry] = -1;
+        const Node last = heap.back();
+        heap.pop_back();
+        if (position < heap.size()) {
+            place(position, last);
+            siftUp(position);
+            siftDown(positions[last.entry]);
+        }
+    }
+
+    /// Remove the entry with the highest count (the newest one if there are several)
+    EntryId pop() {
+        assert(!empty());
+        const EntryId top = heap.front().entry;
+        remove(top);
+        return top;
+    }
+
+private:
+    /// Whether a node belongs above another one
+    static bool before(const Node &a, const Node &b) {
+        return a.count > b.count || (a.count == b.count && a.insertion > b.insertion);
+    }
+
+    void place(const size_t position, const Node &node) {
+        heap[position] = node;
+        positions[node.entry] = position;
+    }
+
+    void siftUp(size_t position) {
+        const Node node = heap[position];
+        while (position > 0 && before(node, heap[(position - 1) / 2])) {
+            place(position, heap[(position - 1) / 2]);
+            position = (position - 1) / 2;
+        }
+        place(position, node);
+    }
+
+    void siftDown(size_t position) {
+        const Node node = heap[position];
+        for (size_t child = 2 * position + 1; child < heap.size(); child = 2 * position + 1) {
+            if (child + 1 < heap.size() && before(heap[child + 1], heap[child])) {
+                ++child;
+            }
+            if (!before(heap[child], node)) {
+                break;
+            }
+            place(position, heap[child]);
+            position = child;
+        }
+        place(position, node);
+    }
+
+    std::vector<Node> heap;
+    /// the position of each entry in the heap, -1 if it is not in the heap
+    std::vector<int> positions;
+    uint64_t numInsertions;
+};
+
 /// RePair Priority Queue
+/**
+ * Entries with a count up to the queue's size are kept in one list per count,
+ * entries with higher counts (there are at most n / size of them for a text of
+ * length n) in an EntryHeap. The most frequent entry is popped first, and the
+ * newest one of several equally frequent entries.
+ */
 struct PriorityQueue {
-    PriorityQueue(const int size = 0) : maxIndex(-1), entries(size) {}
+    PriorityQueue(PQEntryPool &pool, const int size = 0) : maxIndex(-1), entries(size, NO_ENTRY), frequent(), pool(pool) {}
 
     void init(const int size) {
-        entries.resize(size);
+        entries.resize(size, NO_ENTRY);
     }
 
     void clear() {
         entries.clear();
+        frequent.clear();
     }
 
-    bool addEntry(PQEntry *entry) {
-        assert(entry != nullptr);
+    bool addEntry(const EntryId entry) {
+        assert(entry != NO_ENTRY);
         const int index(getIndex(entry));
         bool addEntry = (index >= 0);
 
         if (addEntry) {
             maxIndex = std::max(index, maxIndex);
-            entry->clearFlag();
-            entries[index] = entry->insertInto(entries[index]);
+            pool[entry].clearFlag();
+            if (isHeap(index)) {
+                frequent.push(entry, pool[entry].getCount());
+            } else {
+                entries[index] = pool.insertBefore(entry, entries[index]);
+            }
         }
 
         return addEntry;
     }
 
-    void removeEntry(PQEntry *entry) {
-        assert(entry != nullptr);
+    void removeEntry(const EntryId entry) {
+        assert(entry != NO_ENTRY);
         const int index(getIndex(entry));
         assert(index >= 0);
 
-        entry->setFlag();
-        entries[index] = entry->removeFrom(entries[index]);
+        pool[entry].setFlag();
+        if (isHeap(index)) {
+            frequent.remove(entry);
+        } else {
+            entries[index] = pool.removeFrom(entry, entries[index]);
+        }
     }
 
-    PQEntry* popMaxEntry() {
-        PQEntry *max = nullptr;
+    EntryId popMaxEntry() {
+        EntryId max = NO_ENTRY;
 
         if (!empty()) {
-            max = entries[maxIndex];
-            entries[maxIndex] = max->removeFrom(entries[maxIndex]);
+            if (isHeap(maxIndex)) {
+                max = frequent.pop();
+            } else {
+                max = entries[maxIndex];
+                entries[maxIndex] = pool.removeFrom(max, entries[maxIndex]);
+            }
         }
         return max;
     }
 
     bool empty() {
-        while (maxIndex >= 0 && entries[maxIndex] == nullptr) {
+        while (maxIndex >= 0 && (isHeap(maxIndex) ? frequent.empty() : entries[maxIndex] == NO_ENTRY)) {
             --maxIndex;
         }
         return maxIndex < 0;
     }
 
     friend std::ostream &operator<<(std::ostream &os, const PriorityQueue &pq) {
-        os << "PQ with " << pq.entries.size() << " lists, maxIndex = " << pq.maxIndex << std::endl;
-        for (uint i = 0; i < pq.entries.size(); ++i) {
-            if (pq.entries[i] != NULL) {
-                os << "List " << i << ": " << *pq.entries[i] << std::endl;
+        os << "PQ with " << pq.entries.size() << " lists, maxIndex = " << pq.maxIndex
+           << ", " << pq.frequent.size() << " entries in the heap" << std::endl;
+        for (uint i = 0; i + 1 < pq.entries.size(); ++i) {
+            if (pq.entries[i] != NO_ENTRY) {
+                os << "List " << i << ": ";
+                pq.pool.print(os, pq.entries[i]);
+                os << std::endl;
             }
         }
         return os;
     }
 
 private:
-    int getIndex(PQEntry *entry) const {
-        assert(entry != nullptr);
-        return std::min(entry->getCount() - 2, (int)entries.size() - 1);
+    int getIndex(const EntryId entry) const {
+        assert(entry != NO_ENTRY);
+        return std::min(pool[entry].getCount() - 2, (int)entries.size() - 1);
+    }
+
+    /// Whether the entries of an index are in the heap (rather than a list)
+    bool isHeap(const int index) const {
+        return index == (int)entries.size() - 1;
     }
 
     int maxIndex;
-    std::vector<PQEntry*> entries;
+    /// the first entry of each list (the last one is unused)
+    std::vector<EntryId> entries;
+    /// the entries with the highest counts
+    EntryHeap frequent;
+    PQEntryPool &pool;
 };
 
-}
\ No newline at end of file
+}
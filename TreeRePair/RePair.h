@@ -12,18 +12,16 @@
 namespace RePair {
 
 /// Main RePair compression algorithm
-template <typename DataType, typename InputType>
+/// \tparam compact whether to bit-pack the text (see Records)
+template <typename DataType, typename InputType, bool compact = false>
 struct RePair {
-    RePair(std::vector<InputType> &data) : records(data), hashTable(records), queue(), workingEntries(nullptr), dictionary(records) {}
+    RePair(const std::vector<InputType> &data)
+        : entries(), records(data), hashTable(records, entries), queue(entries), workingEntries(NO_ENTRY), dictionary(records) {}
 
-    ~RePair() {
-        for (PQEntry *entry : pqentries) {
-            if (entry != nullptr) {
-                delete entry;
-            }
-        }
-        pqentries.clear();
-    }
+    /// RePair the symbols in [begin, end) of a larger input
+    template <typename InputIterator>
+    RePair(InputIterator begin, InputIterator end)
+        : entries(), records(begin, end), hashTable(records, entries), queue(entries), workingEntries(NO_ENTRY), dictionary(records) {}
 
     void compress(std::vector<DataType> &out) {
         int maxCount(fillHashTable());
@@ -33,19 +31,22 @@ struct RePair {
         fillQueue();
 
         while (!queue.empty()) {
-            PQEntry *max = queue.popMaxEntry();
+            const EntryId max = queue.popMaxEntry();
             hashTable.remove(max);
-            const int index(max->index);
+            const int index(entries[max].index);
             const DataType first(records.text[index]), second(records.nextSymbol(index));
             const DataType newSymbol = dictionary.addPair(first, second);
+            records.makeRoomFor(newSymbol);
 
             passOne(index, newSymbol, first, second);
             passTwo(index, newSymbol);
+            entries.release(max);
         }
 
         // not needed any more
         queue.clear();
         hashTable.clear();
+        entries.clear();
 
         records.collapse(out);
     }
@@ -54,6 +55,14 @@ struct RePair {
         return dictionary;
     }
 
+    const Records<DataType, compact>& getRecords() const {
+        return records;
+    }
+
+    const HashTable<DataType, compact>& getHashTable() const {
+        return hashTable;
+    }
+
 protected:
     int fillHashTable() {
         int maxCount(1);
@@ -68,10 +77,9 @@ protected:
                 assert(count > 1);
                 maxCount = std::max(maxCount, count);
 
-                PQEntry *entry = new PQEntry(index, count);
-                pqentries.push_back(entry);
+                const EntryId entry = entries.create(index, count);
                 hashTable.insert(entry);
-                workingEntries = entry->insertBefore(workingEntries);
+                workingEntries = entries.insertBefore(entry, workingEntries);
             }
         }
 
@@ -79,9 +87,9 @@ protected:
     }
 
     void fillQueue() {
-        while (workingEntries != nullptr) {
-            PQEntry *entry = workingEntries;
-            workingEntries = entry->removeFrom(workingEntries);
+        while (workingEntries != NO_ENTRY) {
+            const EntryId entry = workingEntries;
+            workingEntries = entries.removeFrom(entry, workingEntries);
             bool addedToQueue = queue.addEntry(entry);
             assert(addedToQueue);
             (void) addedToQueue; // make compiler happy
@@ -139,38 +147,39 @@ protected:
 
     bool removeIndex(const int index) {
         bool seen(false);
-        PQEntry *entry(hashTable.find(index));
-        if (entry == nullptr) {
-            records.remove(index);
+        const EntryId entry(hashTable.find(index));
+        if (entry == NO_ENTRY) {
+            // the pair isn't counted (any more), e.g., it is being replaced
+            records.unlink(index);
         } else {
-            seen = entry->getFlag();
+            seen = entries[entry].getFlag();
             if (!seen) {
                 queue.removeEntry(entry);
-                workingEntries = entry->insertBefore(workingEntries);
+                workingEntries = entries.insertBefore(entry, workingEntries);
             }
 
-            if (entry->index == index) {
-                entry->index = records.next[index];
+            if (entries[entry].index == index) {
+                entries[entry].index = records.next[index];
             }
 
             int countDelta = records.remove(index);
-            entry->changeCount(countDelta);
+            entries[entry].changeCount(countDelta);
 
             // no more occurences? kill it!
-            if (entry->getCount() < 1) {
-                workingEntries = entry->removeFrom(workingEntries);
+            if (entries[entry].getCount() < 1) {
+                workingEntries = entries.removeFrom(entry, workingEntries);
                 hashTable.remove(entry);
+                entries.release(entry);
             }
         }
         return seen;
     }
 
     void createEntryIfNotExists(const int index) {
-        if (hashTable.find(index) == nullptr) {
-            PQEntry *entry = new PQEntry(index, 0);
-            pqentries.push_back(entry);
+        if (hashTable.find(index) == NO_ENTRY) {
+            const EntryId entry = entries.create(index, 0);
             hashTable.insert(entry);
-            workingEntries = entry->insertBefore(workingEntries);
+            workingEntries = entries.insertBefore(entry, workingEntries);
         }
     }
 
@@ -180,7 +189,7 @@ protected:
         do {
             i = nextIndex;
             nextIndex = records.next[i];
-            records.remove(i);
+            records.unlink(i);
 
             int xIndex(records.prevIndex(i)), countDeltaForAy(1);
             DataType x(records.text[xIndex]), y(records.nextSymbol(i));
@@ -200,32 +209,36 @@ protected:
     }
 
     void addIndex(const int index, const int countIncrement) {
-        PQEntry *entry = hashTable.find(index);
-        if (entry != nullptr) {
-            if (entry->getCount() == 0)
-                entry->index = index;
+        const EntryId entry = hashTable.find(index);
+        if (entry != NO_ENTRY) {
+            PQEntry &pqEntry = entries[entry];
+            if (pqEntry.getCount() == 0)
+                pqEntry.index = index;
             else
-                records.insertBefore(index, entry->index);
-            entry->changeCount(countIncrement);
+                records.insertBefore(index, pqEntry.index);
+            pqEntry.changeCount(countIncrement);
         }
     }
 
     void moveWorkingEntriesBackToQueue() {
-        while (workingEntries != nullptr) {
-            PQEntry *entry = workingEntries;
-            workingEntries = entry->removeFrom(workingEntries);
+        while (workingEntries != NO_ENTRY) {
+            const EntryId entry = workingEntries;
+            workingEntries = entries.removeFrom(entry, workingEntries);
 
-            if (!queue.addEntry(entry))
+            if (!queue.addEntry(entry)) {
                 hashTable.remove(entry);
+                entries.release(entry);
+            }
         }
     }
 
 protected:
-    std::vector<PQEntry*> pqentries;
-    Records<DataType> records;
-    HashTable<DataType> hashTable;
+    /// all PQEntries, referred to by their IDs by the hash table, the queue and the working list
+    PQEntryPool entries;
+    Records<DataType, compact> records;
+    HashTable<DataType, compact> hashTable;
     PriorityQueue queue;
-    PQEntry *workingEntries;
+    EntryId workingEntries;
     Dictionary<DataType> dictionary;
 };
 
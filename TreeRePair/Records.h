@@ -1,51 +1,92 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
+#include <iostream>
 #include <limits>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
+#include "../Common.h"
+#include "PackedVector.h"
+
 namespace RePair {
 
 // forward declaration
-template <typename DataType>
+template <typename DataType, bool compact>
 class HashTable;
 
 /// This class holds the text as it undergoes replacements in RePair
-template <typename DataType>
+/**
+ * If `compact` is set, the text and the links are bit-packed (see PackedVector)
+ * to fit larger inputs into memory, at the cost of slower access: the links with
+ * just enough bits for a position in the text, the text with just enough bits for
+ * the input symbols and skipSymbol. The text is widened by one bit whenever a new
+ * symbol doesn't fit any more (see makeRoomFor()), so it only ends up as wide as
+ * the largest symbol RePair creates needs. Either way, skipSymbol is the largest
+ * value that fits into the text.
+ *
+ * Positions are ints, so the input can have at most 2^31 - 3 symbols (leaving
+ * room for the two dummies).
+ */
+template <typename DataType, bool compact = false>
 class Records {
+    template <typename T>
+    using Vector = typename std::conditional<compact, PackedVector<T>, UnpackedVector<T>>::type;
+
 public:
     Records() : symbolCount(0), skipSymbol(std::numeric_limits<DataType>::max()), text(), prev(), next() {}
 
     template <typename InputType>
-    Records(std::vector<InputType> &data) : symbolCount(0), skipSymbol(std::numeric_limits<DataType>::max()), text(), prev(), next() {
-        init(data);
+    Records(const std::vector<InputType> &data) : symbolCount(0), skipSymbol(std::numeric_limits<DataType>::max()), text(), prev(), next() {
+        init(data.cbegin(), data.cend());
     }
 
-    template <typename InputType>
-    void init(std::vector<InputType> &data) {
-        text.reserve(data.size() + 2);
-        text.push_back(skipSymbol); // Dummy for begin
+    /// Records for the symbols in [begin, end), e.g., a block of a larger input
+    template <typename InputIterator>
+    Records(InputIterator begin, InputIterator end) : symbolCount(0), skipSymbol(std::numeric_limits<DataType>::max()), text(), prev(), next() {
+        init(begin, end);
+    }
+
+    template <typename InputIterator>
+    void init(InputIterator begin, InputIterator end) {
+        const size_t length = end - begin;
+        if (length > (size_t)std::numeric_limits<int>::max() - 2) {
+            std::cerr << "RePair supports at most 2^31 - 3 input symbols, but got " << length << std::endl;
+            std::abort();
+        }
+        const size_t size = length + 2;
+        DataType maxSymbol(0);
+        for (auto it = begin; it != end; ++it) {
+            maxSymbol = std::max(maxSymbol, static_cast<DataType>(*it));
+        }
+        const int maxBits = std::numeric_limits<DataType>::digits;
+        text.assign(size, std::min(bitsFor((unsigned long long)maxSymbol + 2), maxBits));
+        // RePair adds at most one symbol per two input symbols, as every replaced pair occurs at least twice
+        text.reserveBits(std::min(bitsFor((unsigned long long)maxSymbol + length / 2 + 3), maxBits));
+        skipSymbol = text.maxValue();
+        assert(skipSymbol > maxSymbol);
+        text.set(0, skipSymbol); // Dummy for begin
 
         // add the input symbols
-        for (auto it = data.cbegin(); it != data.cend(); ++it) {
-            // skipSymbol is reserved and must not occur in input
-            assert(*it != skipSymbol);
-            text.push_back(static_cast<DataType>(*it));
+        for (size_t i = 0; i < length; ++i) {
+            text.set(i + 1, static_cast<DataType>(begin[i]));
         }
 
-        text.push_back(skipSymbol); // Dummy for end
-        assert(text.size() == data.size() + 2);
+        text.set(size - 1, skipSymbol); // Dummy for end
 
         // Create next list
-        next.resize(text.size());
+        const unsigned int linkBits = bitsFor(size);
+        next.assign(size, linkBits);
         for (uint i = 0; i < next.size(); ++i) {
-            next[i] = i;
+            next.set(i, i);
             ++symbolCount;
         }
         symbolCount -= 2; // dummy elements
 
-        prev.assign(text.size(), 0);
+        prev.assign(size, linkBits, 0);
         DataType second(text[1]);
         const int maxIndex = (int)text.size() - 2;
         for (int i = 1, nextI; i < maxIndex; i = nextI) {
@@ -57,21 +98,21 @@ public:
 
             int hashIndex = findInHash(first, second, prev);
             int prevIndex = prev[hashIndex];
-            prev[hashIndex] = i;
+            prev.set(hashIndex, i);
             if (prevIndex != 0) {
                 // add into linked list
-                next[i] = next[prevIndex];
-                next[prevIndex] = i;
+                next.set(i, next[prevIndex]);
+                next.set(prevIndex, i);
             }
         }
 
         // fill in the prev pointers
-        prev[0] = 0;
+        prev.set(0, 0);
         for (int i = 1; i < (int)next.size(); ++i) {
             if (text[i] == skipSymbol) {
-                prev[i] = i - 1;
+                prev.set(i, i - 1);
             } else {
-                prev[next[i]] = i;
+                prev.set(next[i], i);
             }
         }
     }
@@ -118,20 +159,40 @@ public:
         const int thirdIndex(nextIndex(secondIndex));
 
         // weave over the gaps
-        prev[thirdIndex - 1] = index;
-        next[index + 1] = thirdIndex;
+        prev.set(thirdIndex - 1, index);
+        next.set(index + 1, thirdIndex);
 
         // replace symbols
-        text[index] = newSymbol;
-        text[secondIndex] = skipSymbol;
+        text.set(index, newSymbol);
+        text.set(secondIndex, skipSymbol);
     }
 
+    /// Widen the text if `symbol` doesn't fit into it yet, which changes skipSymbol
+    void makeRoomFor(const DataType symbol) {
+        if (symbol < skipSymbol) return;
+        if (text.bits() >= (unsigned int)std::numeric_limits<DataType>::digits) {
+            std::cerr << "RePair created more symbols than its data type can hold" << std::endl;
+            std::abort();
+        }
+        const DataType oldSkipSymbol(skipSymbol);
+        text.widen(text.bits() + 1);
+        skipSymbol = text.maxValue();
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (text[i] == oldSkipSymbol) {
+                text.set(i, skipSymbol);
+            }
+        }
+    }
+
+    /// Remove the pair at `index` from its occurrence list
+    /// \return by how much this changes the number of non-overlapping occurrences (0 or -1),
+    /// which takes time linear in the length of a run of overlapping occurrences, see unlink()
     int remove(const int index) {
         assert(0 <= index && index < (int)prev.size());
         int delta(-1);
 
-        // scan preceding overlapping pairs
-        for (int i = index, p = prev[i]; prevIndex(i) == p; i = p, p = prev[p]) {
+        // scan preceding overlapping pairs (position 0 is the dummy, which has no predecessor)
+        for (int i = index, p = prev[i]; i > 0 && prevIndex(i) == p; i = p, p = prev[p]) {
             delta = -1 - delta;
         }
 
@@ -142,35 +203,40 @@ public:
             }
         }
 
+        unlink(index);
+        return delta;
+    }
+
+    /// Remove the pair at `index` from its occurrence list in constant time, like remove()
+    /// without computing how the number of non-overlapping occurrences changes
+    void unlink(const int index) {
+        assert(0 <= index && index < (int)prev.size());
         // Get the index of the previous occurrence to this one
         int prevIndex = prev[index];
         int nextIndex = next[index];
 
-        next[prevIndex] = nextIndex;
-        prev[nextIndex] = prevIndex;
+        next.set(prevIndex, nextIndex);
+        prev.set(nextIndex, prevIndex);
 
-        prev[index] = index;
-        next[index] = index;
-
-        return delta;
+        prev.set(index, index);
+        next.set(index, index);
     }
 
     // insert pair at index into the DLL so that it precedes nextIndex
     void insertBefore(const int index, const int nextIndex) {
         // nextIndex's old predecessor, will be index's pred. now
         const int prevIndex(prev[nextIndex]);
-        prev[index] = prevIndex;
-        next[index] = nextIndex;
-        next[prevIndex] = index;
-        prev[nextIndex] = index;
+        prev.set(index, prevIndex);
+        next.set(index, nextIndex);
+        next.set(prevIndex, index);
+        prev.set(nextIndex, index);
     }
 
-    int findInHash(const DataType first, const DataType second, const std::vector<int> &hash) const {
-        int previousValue, hashIndex(HashTable<DataType>::hashPair(first, second));
-        do {
+    int findInHash(const DataType first, const DataType second, const Vector<int> &hash) const {
+        int previousValue, hashIndex(HashTable<DataType, compact>::hashPair(first, second) % hash.size());
+        while ((previousValue = hash[hashIndex]) != 0 && !occursAt(previousValue, first, second)) {
             hashIndex = (hashIndex + 1) % hash.size();
-            previousValue = hash[hashIndex];
-        } while (previousValue != 0 && !occursAt(previousValue, first, second));
+        }
         return hashIndex;
     }
 
@@ -182,13 +248,18 @@ public:
         }
     }
 
+    /// The number of bytes used by the text and the links
+    size_t bytes() const {
+        return (text.size() * text.bits() + prev.size() * prev.bits() + next.size() * next.bits()) / 8;
+    }
+
     int symbolCount;
-    const DataType skipSymbol;
-    std::vector<DataType> text;
+    DataType skipSymbol;
+    Vector<DataType> text;
     // previous occurrence index, or, in the case of gaps, index of previous actual symbol
-    std::vector<int> prev;
+    Vector<int> prev;
     // index of next occurrence, or, in the case of gaps, index of next actual symbol
-    std::vector<int> next;
+    Vector<int> next;
 };
 
 }
\ No newline at end of file
@@ -2,7 +2,8 @@
  * Run top tree compression on an XML file
  *
  * Supports classical top tree compression and the
- * RePair combiner (-r flag).
+ * RePair combiner (-r flag). Writes the compressed
+ * file, which can be decoded with `decode`.
  */
 
 
@@ -38,7 +39,12 @@ void usage(char* name) {
     cout << "Usage: " << name << " <options> [filename]" << endl
          << "  -r          enable RePair combiner" << endl
          << "  -m <float>  minimum merge ratio for RePair combiner, below" << endl
-         << "              which fallback is invoked (default: 1.26)" << endl;
+         << "              which fallback is invoked (default: 1.26)" << endl
+         << "  -o <file>   output file (default: /tmp/foo)" << endl
+         << "  -e <coders> entropy coders for the label, structure, merge type and pointer" << endl
+         << "              streams, one letter each: h = Huffman, r = rANS, for the labels also" << endl
+         << "              f = front coding, and for the pointers also v = Stream VByte (faster" << endl
+         << "              decoding) (default: hhhh)" << endl;
 }
 
 int main(int argc, char **argv) {
@@ -58,6 +64,13 @@ int main(int argc, char **argv) {
         filename = (arg == "") ? filename : arg;
     }
     const double minRatio = argParser.get<double>("m", 1.26);
+    const string outputFilename = argParser.get<string>("o", "/tmp/foo");
+    StreamCoders coders;
+    if (!coders.parse(argParser.get<string>("e", "hhhh"))) {
+        cout << "Invalid entropy coder specification, see " << argv[0] << " -h" << endl;
+        exit(1);
+    }
+    const long long inputSize = getFileSize(filename);
 
     OrderedTree<TreeNode, TreeEdge> t;
     Labels<string> labels;
@@ -75,7 +88,7 @@ int main(int argc, char **argv) {
     TopDag<string> dag(t._numNodes, labels);
     const long long treeSize = TreeSizeEstimation<OrderedTree<TreeNode, TreeEdge>>::compute(t, labels);
 
-    Timer timer;
+    Timer timer, totalTimer;
     if (useRePair) {
         RePairCombiner<OrderedTree<TreeNode, TreeEdge>, string> topDagConstructor(t, dag);
         topDagConstructor.construct(NULL, minRatio);
@@ -98,7 +111,18 @@ int main(int argc, char **argv) {
     cout << "Top dag has " << nodes << " nodes (" << nodePercentage << "%), "
          << edges << " edges (" << edgePercentage << "% of original tree, " << ratio << ":1)" << endl;
 
-    long long bits = FileWriter::write(dag, labels, "/tmp/foo");
+    timer.reset();
+    long long bits = FileWriter::write(dag, outputFilename, true, coders);
+    if (bits < 0) {
+        cout << "Could not write output file " << outputFilename << ", aborting" << endl;
+        exit(1);
+    }
+    const double encodingDuration = timer.getAndReset();
+    const double compressionDuration = totalTimer.get();
+    // bytes per microsecond = MB/s
+    const double throughput = inputSize / (compressionDuration * 1000);
+    cout << "Encoding took " << encodingDuration << "ms; compression took " << compressionDuration << "ms in total ("
+         << throughput << " MB/s of XML input)" << endl;
 
     const std::streamsize precision = cout.precision();
     cout << "Output file needs " << bits << " bits (" << (bits+7)/8 << " bytes), vs " << (treeSize+7)/8 << " bytes for orig succ tree, "
@@ -111,6 +135,7 @@ int main(int argc, char **argv) {
          << " succinct=" << treeSize
          << " minRatio=" << minRatio
          << " repair=" << useRePair
+         << " coders=" << coders.toString()
          << " nodes=" << nodes
          << " origNodes=" << origNodes
          << " edges=" << edges
@@ -118,6 +143,9 @@ int main(int argc, char **argv) {
          << " file=" << filename
          << " origHeight=" << origHeight
          << " origAvgDepth=" << origAvgDepth
+         << " encodingTime=" << encodingDuration
+         << " compressionTime=" << compressionDuration
+         << " throughput=" << throughput
          //<< " ttAvgDepth=" << ttAvgDepth
          //<< " ttMinDepth=" << ttMinDepth
          //<< " ttHeight=" << ttHeight
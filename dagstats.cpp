@@ -0,0 +1,159 @@
+/*
+ * Compute aggregate statistics of an XML file's tree
+ * on its Top DAG, without unpacking it.
+ *
+ * Reports node counts, height, average depth, and
+ * label, depth and fan-out histograms.
+ */
+
+#include <functional>
+#include <iostream>
+#include <string>
+
+// Data Structures
+#include "Edges.h"
+#include "Nodes.h"
+#include "OrderedTree.h"
+#include "TopDag.h"
+
+// Algorithms
+#include "RePairCombiner.h"
+#include "TopDagAnalytics.h"
+#include "TopDagConstructor.h"
+
+// Utils
+#include "ArgParser.h"
+#include "Timer.h"
+#include "XML.h"
+
+
+using std::cout;
+using std::endl;
+using std::string;
+
+void usage(char* name) {
+    cout << "Usage: " << name << " <options> [filename]" << endl
+         << "  -r          enable RePair combiner" << endl
+         << "  -v          print the histograms" << endl
+         << "  -c          check the results against the uncompressed tree" << endl;
+}
+
+int main(int argc, char **argv) {
+    ArgParser argParser(argc, argv);
+    if (argParser.isSet("h") || argParser.isSet("-help")) {
+        usage(argv[0]);
+        return 0;
+    }
+
+    const bool useRePair = argParser.isSet("r");
+    string filename = "data/1998statistics.xml";
+    if (argParser.numDataArgs() > 0) {
+        filename = argParser.getDataArg(0);
+    }
+    const bool verbose = argParser.isSet("v");
+    const bool check = argParser.isSet("c");
+
+    OrderedTree<TreeNode, TreeEdge> t;
+    Labels<string> labels;
+    if (!XmlParser<OrderedTree<TreeNode, TreeEdge>>::parse(filename, t, labels)) {
+        cout << "Could not parse input file, aborting" << endl;
+        exit(1);
+    }
+    cout << t.summary() << endl;
+
+    // only keep a copy of the tree if we need it for checking
+    OrderedTree<TreeNode, TreeEdge> treeCopy(check ? t : OrderedTree<TreeNode, TreeEdge>());
+
+    TopDag<string> dag(t._numNodes, labels);
+    Timer timer;
+    if (useRePair) {
+        RePairCombiner<OrderedTree<TreeNode, TreeEdge>, string> topDagConstructor(t, dag, false);
+        topDagConstructor.construct();
+    } else {
+        TopDagConstructor<OrderedTree<TreeNode, TreeEdge>, string> topDagConstructor(t, dag, false);
+        topDagConstructor.construct();
+    }
+    const int dagNodes((int)dag.nodes.size() - 1);
+    cout << "Top DAG construction took " << timer.getAndReset() << "ms, Top DAG has " << dagNodes << " nodes" << endl;
+
+    TopDagAnalytics<string> analytics(dag);
+    const unsigned long long numNodes = analytics.numNodes();
+    const int height = analytics.height();
+    const double avgDepth = analytics.avgDepth();
+    const double summaryDuration = timer.getAndReset();
+    cout << "Nodes: " << numNodes << " Height: " << height << " Avg depth: " << avgDepth
+         << " (" << summaryDuration << "ms)" << endl;
+
+    std::unordered_map<string, unsigned long long> labelHistogram;
+    std::map<uint, unsigned long long> fanOutHistogram;
+    vector<unsigned long long> depthHistogram;
+    analytics.labelHistogram(labelHistogram);
+    analytics.fanOutHistogram(fanOutHistogram);
+    analytics.depthHistogram(depthHistogram);
+    const double histogramDuration = timer.getAndReset();
+    cout << labelHistogram.size() << " labels, " << fanOutHistogram.size() << " different fan-outs, "
+         << depthHistogram.size() - 1 << " levels (histograms took " << histogramDuration << "ms)" << endl;
+
+    if (verbose) {
+        cout << "Labels:" << endl;
+        for (auto &entry : labelHistogram) {
+            cout << "\t" << entry.first << ": " << entry.second << endl;
+        }
+        cout << "Fan-out:" << endl;
+        for (auto &entry : fanOutHistogram) {
+            cout << "\t" << entry.first << ": " << entry.second << endl;
+        }
+        cout << "Depth:" << endl;
+        for (uint depth = 1; depth < depthHistogram.size(); ++depth) {
+            cout << "\t" << depth << ": " << depthHistogram[depth] << endl;
+        }
+    }
+
+    if (check) {
+        std::unordered_map<string, unsigned long long> treeLabelHistogram;
+        std::map<uint, unsigned long long> treeFanOutHistogram;
+        vector<unsigned long long> treeDepthHistogram(1, 0);
+        const std::function<void (const int, const uint)> traverse([&](const int nodeId, const uint depth) {
+            treeLabelHistogram[labels[nodeId]]++;
+            if (treeDepthHistogram.size() <= depth) {
+                treeDepthHistogram.resize(depth + 1, 0);
+            }
+            treeDepthHistogram[depth]++;
+            uint children(0);
+            FORALL_OUTGOING_EDGES(treeCopy, nodeId, edge) {
+                if (edge->valid) {
+                    traverse(edge->headNode, depth + 1);
+                    ++children;
+                }
+            }
+            treeFanOutHistogram[children]++;
+        });
+        traverse(0, 1);
+        const int treeHeight(treeCopy.height());
+        const double treeAvgDepth(treeCopy.avgDepth());
+        const double treeDuration = timer.getAndReset();
+
+        const bool correct = (numNodes == (unsigned long long)treeCopy._numNodes) && (height == treeHeight) &&
+            (std::abs(avgDepth - treeAvgDepth) < 1e-9 * treeAvgDepth) && (labelHistogram == treeLabelHistogram) &&
+            (fanOutHistogram == treeFanOutHistogram) && (depthHistogram == treeDepthHistogram);
+        cout << "Tree: Nodes: " << treeCopy._numNodes << " Height: " << treeHeight << " Avg depth: " << treeAvgDepth
+             << " (statistics on the uncompressed tree took " << treeDuration << "ms): "
+             << (correct ? "results match" : "RESULTS DIFFER") << endl;
+        if (!correct) {
+            return 1;
+        }
+    }
+
+    cout << "RESULT"
+         << " file=" << filename
+         << " repair=" << useRePair
+         << " origNodes=" << numNodes
+         << " nodes=" << dagNodes
+         << " height=" << height
+         << " avgDepth=" << avgDepth
+         << " summaryTime=" << summaryDuration
+         << " histogramTime=" << histogramDuration
+         << endl;
+
+    return 0;
+}
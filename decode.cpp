@@ -0,0 +1,137 @@
+/*
+ * Decode a file written by `coding`
+ *
+ * Reads the Top DAG, unpacks it into its top tree and
+ * then into the original tree, which can be written
+ * as XML or compared with the original XML file.
+ */
+
+
+#include <iostream>
+#include <string>
+
+// Data Structures
+#include "Edges.h"
+#include "Nodes.h"
+#include "OrderedTree.h"
+#include "TopDag.h"
+#include "TopTree.h"
+
+// Algorithms
+#include "TopDagUnpacker.h"
+#include "TopTreeUnpacker.h"
+
+// Utils
+#include "ArgParser.h"
+#include "FileReader.h"
+#include "Timer.h"
+#include "XML.h"
+
+
+using std::cout;
+using std::endl;
+using std::string;
+
+void usage(char* name) {
+    cout << "Usage: " << name << " <options> [filename]" << endl
+         << "  -o <file>   write the decoded tree as XML" << endl
+         << "  -c <file>   compare the decoded tree with the original XML file" << endl;
+}
+
+int main(int argc, char **argv) {
+    ArgParser argParser(argc, argv);
+    if (argParser.isSet("h") || argParser.isSet("-help")) {
+        usage(argv[0]);
+        return 0;
+    }
+
+    string filename = "/tmp/foo";
+    if (argParser.numDataArgs() > 0) {
+        filename = argParser.getDataArg(0);
+    }
+    const string outputFilename = argParser.get<string>("o", "");
+    const string originalFilename = argParser.get<string>("c", "");
+
+    Timer timer;
+    FileReader reader(filename);
+    if (!reader.good()) {
+        cout << "Could not read " << filename << " or it is not a Top DAG file, aborting" << endl;
+        exit(1);
+    }
+    // front-coded labels are only decoded when the DAG takes its leaves' labels below
+    const bool frontCoded = (reader.getStreamCoders().labels == FRONT_CODER);
+    Labels<string> labels(frontCoded ? 0 : reader.getNumLeaves());
+    FrontCodedLabels frontCodedLabels;
+    if (!(frontCoded ? reader.readLabels(frontCodedLabels) : reader.readLabels(labels))) {
+        cout << "Could not decode labels, aborting" << endl;
+        exit(1);
+    }
+    const LabelsT<string> &plainLabels = labels, &codedLabels = frontCodedLabels;
+    TopDag<string> dag(reader.getNumLeaves(), frontCoded ? codedLabels : plainLabels);
+    if (!reader.readDag(dag)) {
+        cout << "Could not decode the Top DAG, aborting" << endl;
+        exit(1);
+    }
+    const double decodingDuration = timer.getAndReset();
+    const long long fileSize = reader.getFileSize();
+    cout << "Decoded Top DAG with " << dag.nodes.size() - 1 << " nodes from " << fileSize << " bytes in "
+         << decodingDuration << "ms" << endl;
+
+    TopTree<string> topTree(reader.getNumTreeNodes());
+    TopDagUnpacker<string> dagUnpacker(dag, topTree);
+    dagUnpacker.unpack();
+    OrderedTree<TreeNode, TreeEdge> tree;
+    Labels<string> treeLabels(reader.getNumTreeNodes());
+    TopTreeUnpacker<OrderedTree<TreeNode, TreeEdge>, string> treeUnpacker(topTree, tree, treeLabels);
+    treeUnpacker.unpack();
+    const double unpackingDuration = timer.getAndReset();
+    const double decompressionDuration = decodingDuration + unpackingDuration;
+    cout << "Unpacked " << tree.summary() << " in " << unpackingDuration << "ms" << endl;
+
+    long long xmlSize(-1);
+    if (outputFilename != "") {
+        XmlWriter<OrderedTree<TreeNode, TreeEdge>>::write(tree, treeLabels, outputFilename);
+        xmlSize = getFileSize(outputFilename);
+        cout << "Wrote " << xmlSize << " bytes of XML to " << outputFilename << " in " << timer.getAndReset() << "ms" << endl;
+    }
+
+    bool correct(true);
+    if (originalFilename != "") {
+        OrderedTree<TreeNode, TreeEdge> originalTree;
+        Labels<string> originalLabels;
+        if (!XmlParser<OrderedTree<TreeNode, TreeEdge>>::parse(originalFilename, originalTree, originalLabels)) {
+            cout << "Could not parse " << originalFilename << ", aborting" << endl;
+            exit(1);
+        }
+        correct = tree.isEqual<Labels<string>>(originalTree, treeLabels, originalLabels, true);
+        cout << "Decoded tree " << (correct ? "matches" : "DOES NOT MATCH") << " " << originalFilename << endl;
+        if (xmlSize < 0) {
+            xmlSize = getFileSize(originalFilename);
+        }
+    }
+
+    // bytes per microsecond = MB/s
+    const double compressedThroughput = fileSize / (decompressionDuration * 1000);
+    const double xmlThroughput = xmlSize / (decompressionDuration * 1000);
+    cout << "Decompression took " << decompressionDuration << "ms: " << compressedThroughput << " MB/s of compressed input";
+    if (xmlSize >= 0) {
+        cout << ", " << xmlThroughput << " MB/s of XML";
+    }
+    cout << endl;
+
+    cout << "RESULT"
+         << " file=" << filename
+         << " compressed=" << fileSize
+         << " coders=" << reader.getStreamCoders().toString()
+         << " xml=" << xmlSize
+         << " nodes=" << dag.nodes.size() - 1
+         << " origNodes=" << tree._numNodes
+         << " decodingTime=" << decodingDuration
+         << " unpackingTime=" << unpackingDuration
+         << " throughput=" << compressedThroughput
+         << " xmlThroughput=" << (xmlSize >= 0 ? xmlThroughput : 0)
+         << " correct=" << correct
+         << endl;
+
+    return correct ? 0 : 1;
+}
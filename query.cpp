@@ -0,0 +1,208 @@
+/*
+ * Evaluate path queries on the Top DAG of an XML file
+ *
+ * Supports XPath-lite queries with child ("/") and
+ * descendant ("//") steps, e.g. "/dblp/article/author"
+ * or "//title". Evaluation happens directly on the
+ * Top DAG, without unpacking it, or on a navigable
+ * Top DAG file that is memory-mapped (see MappedTopDag).
+ */
+
+#include <functional>
+#include <iostream>
+#include <string>
+
+// Data Structures
+#include "Edges.h"
+#include "MappedTopDag.h"
+#include "Nodes.h"
+#include "OrderedTree.h"
+#include "TopDag.h"
+
+// Algorithms
+#include "PathQuery.h"
+#include "RePairCombiner.h"
+#include "TopDagConstructor.h"
+
+// Utils
+#include "ArgParser.h"
+#include "Timer.h"
+#include "XML.h"
+
+
+using std::cout;
+using std::endl;
+using std::string;
+
+void usage(char* name) {
+    cout << "Usage: " << name << " <options> [filename]" << endl
+         << "  -q <query>  path query, e.g. /dblp/article/author or //title" << endl
+         << "  -r          enable RePair combiner" << endl
+         << "  -p          print the preorder numbers of the matches" << endl
+         << "  -c          check the result against a traversal of the uncompressed tree" << endl
+         << "  -w <file>   write the Top DAG to a navigable file" << endl
+         << "  -m <file>   query a navigable file written with -w in place instead of an XML file" << endl
+         << "              (the XML file is only read for -c)" << endl;
+}
+
+/// Evaluate a query on a Top DAG or MappedTopDag and print the timings
+/// \param positions output, the preorder numbers of the matches
+/// \return the number of matches
+template <typename DAGType>
+unsigned long long evaluate(const DAGType &dag, const vector<PathStep<string>> &steps, const string &query,
+                            vector<unsigned long long> &positions, double &countDuration, double &positionDuration) {
+    Timer timer;
+    PathQuery<string, DAGType> pathQuery(dag, steps);
+    const unsigned long long matches = pathQuery.count();
+    countDuration = timer.getAndReset();
+    cout << "Query " << query << " has " << matches << " matches; counting took " << countDuration << "ms ("
+         << pathQuery.numEvaluations() << " cluster evaluations, " << pathQuery.numStates() << " states)" << endl;
+
+    pathQuery.positions(positions);
+    positionDuration = timer.getAndReset();
+    cout << "Retrieving match positions took " << positionDuration << "ms" << endl;
+    return matches;
+}
+
+/// Evaluate a query on the uncompressed tree, for comparison
+template <typename TreeType>
+void evaluateOnTree(const TreeType &tree, const Labels<string> &labels, const vector<PathStep<string>> &steps,
+                    vector<unsigned long long> &positions) {
+    unsigned long long preorderNumber(0);
+    const std::function<void (const int, const uint64_t)> traverse([&](const int nodeId, const uint64_t active) {
+        uint64_t next(0);
+        for (uint step = 0; step < steps.size(); ++step) {
+            if ((active & ((uint64_t)1 << step)) == 0) continue;
+            if (steps[step].matches(labels[nodeId])) {
+                if (step + 1 == steps.size()) {
+                    positions.push_back(preorderNumber);
+                } else {
+                    next |= (uint64_t)1 << (step + 1);
+                }
+            }
+            if (steps[step].descendant) {
+                next |= (uint64_t)1 << step;
+            }
+        }
+        ++preorderNumber;
+
+        FORALL_OUTGOING_EDGES(tree, nodeId, edge) {
+            if (edge->valid) {
+                traverse(edge->headNode, next);
+            }
+        }
+    });
+    traverse(0, 1);
+}
+
+int main(int argc, char **argv) {
+    ArgParser argParser(argc, argv);
+    if (argParser.isSet("h") || argParser.isSet("-help")) {
+        usage(argv[0]);
+        return 0;
+    }
+
+    const bool useRePair = argParser.isSet("r");
+    string filename = "data/1998statistics.xml";
+    if (argParser.numDataArgs() > 0) {
+        filename = argParser.getDataArg(0);
+    }
+    const string query = argParser.get<string>("q", "//title");
+    const bool printPositions = argParser.isSet("p");
+    const bool check = argParser.isSet("c");
+
+    vector<PathStep<string>> steps;
+    if (!PathQueryParser::parse(query, steps) || steps.size() >= 64) {
+        cout << "Could not parse query " << query << ", aborting" << endl;
+        exit(1);
+    }
+
+    const string mappedFile = argParser.get<string>("m", "");
+    const string outputFile = argParser.get<string>("w", "");
+
+    OrderedTree<TreeNode, TreeEdge> t;
+    Labels<string> labels;
+    if ((mappedFile.empty() || check) && !XmlParser<OrderedTree<TreeNode, TreeEdge>>::parse(filename, t, labels)) {
+        cout << "Could not parse input file, aborting" << endl;
+        exit(1);
+    }
+    unsigned long long origNodes(t._numNodes);
+    // only keep a copy of the tree if we need it for checking
+    OrderedTree<TreeNode, TreeEdge> treeCopy(check ? t : OrderedTree<TreeNode, TreeEdge>());
+
+    int dagNodes;
+    double openDuration(0), countDuration, positionDuration;
+    unsigned long long matches;
+    vector<unsigned long long> positions;
+    Timer timer;
+    if (mappedFile.empty()) {
+        cout << t.summary() << endl;
+        TopDag<string> dag(t._numNodes, labels);
+        if (useRePair) {
+            RePairCombiner<OrderedTree<TreeNode, TreeEdge>, string> topDagConstructor(t, dag, false);
+            topDagConstructor.construct();
+        } else {
+            TopDagConstructor<OrderedTree<TreeNode, TreeEdge>, string> topDagConstructor(t, dag, false);
+            topDagConstructor.construct();
+        }
+        dagNodes = (int)dag.nodes.size() - 1;
+        cout << "Top DAG construction took " << timer.getAndReset() << "ms, Top DAG has " << dagNodes << " nodes" << endl;
+
+        if (!outputFile.empty()) {
+            const long long bits = MappedTopDagWriter::write(dag, outputFile);
+            if (bits < 0) {
+                cout << "Could not write " << outputFile << ", aborting" << endl;
+                exit(1);
+            }
+            cout << "Wrote " << bits / 8 << " bytes to " << outputFile << " in " << timer.getAndReset() << "ms" << endl;
+        }
+
+        matches = evaluate(dag, steps, query, positions, countDuration, positionDuration);
+    } else {
+        MappedTopDag dag(mappedFile);
+        if (!dag.good()) {
+            cout << "Could not open " << mappedFile << ", aborting" << endl;
+            exit(1);
+        }
+        openDuration = timer.getAndReset();
+        dagNodes = (int)dag.nodes.size() - 1;
+        origNodes = dag.getNumTreeNodes();
+        cout << "Opening " << mappedFile << " (" << dag.getFileSize() << " bytes) took " << openDuration
+             << "ms, Top DAG has " << dagNodes << " nodes" << endl;
+
+        matches = evaluate(dag, steps, query, positions, countDuration, positionDuration);
+    }
+    if (printPositions) {
+        for (unsigned long long position : positions) {
+            cout << position << endl;
+        }
+    }
+
+    if (check) {
+        vector<unsigned long long> treePositions;
+        timer.reset();
+        evaluateOnTree(treeCopy, labels, steps, treePositions);
+        const double treeDuration = timer.getAndReset();
+        const bool correct = (treePositions == positions) && (matches == positions.size());
+        cout << "Evaluation on the uncompressed tree took " << treeDuration << "ms, found " << treePositions.size()
+             << " matches: " << (correct ? "results match" : "RESULTS DIFFER") << endl;
+        if (!correct) {
+            return 1;
+        }
+    }
+
+    cout << "RESULT"
+         << " file=" << (mappedFile.empty() ? filename : mappedFile)
+         << " query=" << query
+         << " repair=" << useRePair
+         << " mapped=" << !mappedFile.empty()
+         << " matches=" << matches
+         << " origNodes=" << origNodes
+         << " nodes=" << dagNodes
+         << " openTime=" << openDuration
+         << " countTime=" << countDuration
+         << " positionTime=" << positionDuration
+         << endl;
+
+    return 0;
+}
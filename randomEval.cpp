@@ -46,6 +46,7 @@ void usage(char* name) {
          << "  -l <int>  number of different labels to assign to the nodes (default: 2)" << endl
          << "  -s <int>  seed (default: 12345678)" << endl
          << "  -r        use RePair-inspired combiner" << endl
+         << "  -b        bound the top tree height to O(log n) (with -r)" << endl
          << "  -g <file> set output file for edge compression ratios (default: no output)" << endl
          << "  -o <file> set output file for debug information (default: no output)" << endl
          << "  -w <path> set output folder for generated trees as XML files (default: don't write)" << endl
@@ -57,7 +58,7 @@ void usage(char* name) {
 std::mutex debugMutex;
 
 void runIteration(const int iteration, RandomGeneratorType &generator, const uint seed, const int size,
-        const int numLabels, const bool useRepair, const bool verbose, const bool extraVerbose,
+        const int numLabels, const bool useRepair, const bool boundedHeight, const bool verbose, const bool extraVerbose,
         Statistics &statistics, ProgressBar &bar, const string &treePath) {
     // Seed RNG
     generator.seed(seed);
@@ -91,7 +92,7 @@ void runIteration(const int iteration, RandomGeneratorType &generator, const uin
     TopDag<int> dag(tree._numNodes, labels);
     if (useRepair) {
         RePairCombiner<OrderedTree<TreeNode, TreeEdge>, int> topDagConstructor(tree, dag, verbose, extraVerbose);
-        topDagConstructor.construct(&debugInfo);
+        topDagConstructor.construct(&debugInfo, 1.2, boundedHeight);
     } else {
         TopDagConstructor<OrderedTree<TreeNode, TreeEdge>, int> topDagConstructor(tree, dag, verbose, extraVerbose);
         topDagConstructor.construct(&debugInfo);
@@ -107,12 +108,13 @@ void runIteration(const int iteration, RandomGeneratorType &generator, const uin
     if (verbose)
         cout << "Top DAG construction took " << timer.get() << "ms" << endl;
     timer.reset();
-/*
-    debugInfo.topTreeHeight = topTree.height();
-    debugInfo.topTreeAvgDepth = topTree.avgDepth();
-    debugInfo.topTreeMinDepth = topTree.minDepth();
+    debugInfo.topTreeHeight = dag.height();
+    debugInfo.topTreeAvgDepth = dag.avgDepth();
+    debugInfo.topTreeMinDepth = dag.minDepth();
     debugInfo.statDuration += timer.getAndReset();
-*/
+    if (verbose)
+        cout << "Top tree has height " << debugInfo.topTreeHeight << " (leaves at depth >= "
+             << debugInfo.topTreeMinDepth << ", avg depth " << debugInfo.topTreeAvgDepth << ")" << endl;
 
     const int edges = dag.countEdges();
     const double percentage = (edges * 100.0) / treeEdges;
@@ -146,6 +148,7 @@ int main(int argc, char **argv) {
     const bool verbose = argParser.isSet("v") || argParser.isSet("vv");
     const bool extraVerbose = argParser.isSet("vv");
     const bool useRepair = argParser.isSet("r");
+    const bool boundedHeight = argParser.isSet("b");
     const string ratioFilename = argParser.get<string>("g", "");
     const string debugFilename = argParser.get<string>("o", "");
     const string treePath = argParser.get<string>("w", "");
@@ -177,7 +180,7 @@ int main(int argc, char **argv) {
     auto worker = [&](int start, int end) {
         RandomGeneratorType engine{};
         for (int i = start; i < end; ++i) {
-            runIteration(i, engine, seeds[i], size, numLabels, useRepair, verbose, extraVerbose, statistics, bar, treePath);
+            runIteration(i, engine, seeds[i], size, numLabels, useRepair, boundedHeight, verbose, extraVerbose, statistics, bar, treePath);
         }
     };
 
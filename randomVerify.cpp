@@ -47,6 +47,7 @@ void usage(char* name) {
          << "  -l <int>  number of different labels to assign to the nodes (default: 2)" << endl
          << "  -s <int>  seed (default: 12345678)" << endl
          << "  -r <file> set output file for edge compression ratios (default: no output)" << endl
+         << "  -b        bound the top tree height to O(log n) (with RePair)" << endl
          << "  -o <file> set output file for debug information (default: no output)" << endl
          << "  -w <path> set output folder for generated trees as XML files (default: don't write)" << endl
          << "  -t <int>  number of threads to use (default: #cores)" << endl
@@ -57,7 +58,7 @@ void usage(char* name) {
 std::mutex debugMutex;
 
 void runIteration(const int iteration, RandomGeneratorType &generator, const uint seed, const int size,
-        const int numLabels, const bool useRePair, const bool verbose, const bool extraVerbose,
+        const int numLabels, const bool useRePair, const bool boundedHeight, const bool verbose, const bool extraVerbose,
         Statistics &statistics, ProgressBar &bar, const string &treePath) {
     // Seed RNG
     generator.seed(seed);
@@ -94,7 +95,7 @@ void runIteration(const int iteration, RandomGeneratorType &generator, const uin
     TopDag<int> dag(tree._numNodes, labels);
     if (useRePair) {
         RePairCombiner<OrderedTree<TreeNode, TreeEdge>, int> topDagConstructor(tree, dag, verbose, extraVerbose);
-        topDagConstructor.construct(&debugInfo);
+        topDagConstructor.construct(&debugInfo, 1.2, boundedHeight);
     } else {
         TopDagConstructor<OrderedTree<TreeNode, TreeEdge>, int> topDagConstructor(tree, dag, verbose, extraVerbose);
         topDagConstructor.construct(&debugInfo);
@@ -105,12 +106,13 @@ void runIteration(const int iteration, RandomGeneratorType &generator, const uin
         cout << "Top DAG construction took " << timer.get() << "ms" << endl;
     timer.reset();
 
-/*
-    debugInfo.topTreeHeight = topTree.height();
-    debugInfo.topTreeAvgDepth = topTree.avgDepth();
-    debugInfo.topTreeMinDepth = topTree.minDepth();
+    debugInfo.topTreeHeight = dag.height();
+    debugInfo.topTreeAvgDepth = dag.avgDepth();
+    debugInfo.topTreeMinDepth = dag.minDepth();
     debugInfo.statDuration += timer.getAndReset();
-*/
+    if (verbose)
+        cout << "Top tree has height " << debugInfo.topTreeHeight << " (leaves at depth >= "
+             << debugInfo.topTreeMinDepth << ", avg depth " << debugInfo.topTreeAvgDepth << ")" << endl;
 
     // Unpack top DAG to topTree
     TopTree<int> topTree(size + 1);
@@ -161,6 +163,7 @@ int main(int argc, char **argv) {
     const uint numLabels = argParser.get<uint>("l", 2);
     const uint seed = argParser.get<uint>("s", 12345678);
     const bool useRePair = argParser.isSet("r");
+    const bool boundedHeight = argParser.isSet("b");
     const bool verbose = argParser.isSet("v") || argParser.isSet("vv");
     const bool extraVerbose = argParser.isSet("vv");
     const string ratioFilename = argParser.get<string>("r", "");
@@ -195,7 +198,7 @@ int main(int argc, char **argv) {
     auto worker = [&](int start, int end) {
         RandomGeneratorType engine{};
         for (int i = start; i < end; ++i) {
-            runIteration(i, engine, seeds[i], size, numLabels, useRePair, verbose, extraVerbose, statistics, bar, treePath);
+            runIteration(i, engine, seeds[i], size, numLabels, useRePair, boundedHeight, verbose, extraVerbose, statistics, bar, treePath);
         }
     };
 
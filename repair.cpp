@@ -2,7 +2,11 @@
  * Applies RePair to the parenthesis bitstring of a tree.
  */
 
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
 #include <iostream>
+#include <random>
 #include <string>
 
 // Data Structures
@@ -11,6 +15,7 @@
 #include "OrderedTree.h"
 
 // Algorithms
+#include "TreeRePair/BlockRePair.h"
 #include "TreeRePair/Coder.h"
 #include "TreeRePair/Prepair.h"
 #include "TreeRePair/RePair.h"
@@ -26,14 +31,40 @@ using std::cout;
 using std::endl;
 using std::string;
 
+/// Encode the output and dictionary of RePair with Huffman codes
+/// \return the number of bits needed
 template <typename InType, typename DataType>
-long long compress(vector<InType> &data, const std::string &description, const bool skipPrepair = false, const bool verbose = false) {
-    Timer timer;
-    cout << "RePair-ing the " << description;
+long long encode(std::vector<DataType> &output, RePair::Dictionary<DataType> &dictionary,
+                 std::unordered_map<InType, InType> &inputTransformations, const bool skipPrepair, const bool verbose) {
+    cout << "Compressed representation has " << output.size() << " symbols, dictionary has " << dictionary.size() << " entries (" << dictionary.numSymbols() << " symbols)" << endl;
 
+    if (verbose) {
+        for (auto elem : output) {
+            std::cout << elem << " ";
+        }
+        std::cout << std::endl << dictionary;
+    }
 
-    std::unordered_map<InType, InType> inputTransformations;
+    RePair::Coder<DataType> coder(output, dictionary);
     if (!skipPrepair) {
+        coder.codeInputMapping(inputTransformations);
+    }
+    coder.compute();
+    cout << coder.huff << " + " << coder.huff.getBitsForTableLabels(coder.getBitsPerSymbol()) << " bits = " << (coder.getBitsNeeded() + 7) / 8 << " Bytes" << endl;
+    return coder.getBitsNeeded();
+}
+
+template <typename InType, typename DataType, bool compact>
+long long compress(vector<InType> &data, const std::string &description, const int numBlocks,
+                   std::unordered_map<InType, InType> &inputTransformations, const bool skipPrepair, const bool verbose) {
+    Timer timer;
+    cout << "RePair-ing the " << description;
+    if (numBlocks > 1) {
+        cout << " in " << numBlocks << " blocks";
+    }
+
+    // data is only prepared once, later runs on it reuse the transformations
+    if (!skipPrepair && inputTransformations.empty()) {
         cout << ", preparing… " << flush;
         RePair::Prepair<InType>::prepare(data, inputTransformations);
         cout << timer.getAndReset() << "ms";
@@ -41,29 +72,58 @@ long long compress(vector<InType> &data, const std::string &description, const b
 
     cout << ", initialising… " << flush;
     std::vector<DataType> output;
-    RePair::RePair<DataType, InType> repair(data);
+    if (numBlocks > 1) {
+        RePair::BlockRePair<DataType, InType, compact> repair(data, numBlocks);
+        cout << timer.getAndReset() << "ms, compressing… " << flush;
+
+        repair.compress(output);
+        RePair::Dictionary<DataType> &dictionary = repair.getDictionary();
+        cout << "done (" << timer.getAndReset() << "ms)" << endl;
+        cout << "Merged the dictionaries of " << repair.getNumBlocks() << " blocks, " << repair.getNumBlockRules()
+             << " rules in total, " << repair.getNumBlockRules() - dictionary.size() << " of them shared" << endl;
+        return encode(output, dictionary, inputTransformations, skipPrepair, verbose);
+    }
+
+    RePair::RePair<DataType, InType, compact> repair(data);
     cout << timer.getAndReset() << "ms, compressing… " << flush;
+    const RePair::Records<DataType, compact> &records = repair.getRecords();
+    const unsigned int initialTextBits(records.text.bits());
 
     repair.compress(output);
     RePair::Dictionary<DataType> &dictionary = repair.getDictionary();
     cout << "done (" << timer.getAndReset() << "ms)" << endl;
+    const RePair::HashTable<DataType, compact> &hashTable = repair.getHashTable();
+    cout << "Hash table: " << hashTable.getNumLookups() << " lookups, "
+         << (double)hashTable.getNumProbes() / std::max<uint64_t>(hashTable.getNumLookups(), 1) << " probes per lookup, "
+         << hashTable.getMaxSize() << " slots at most" << endl;
+    cout << "Text and links took " << records.bytes() << " bytes (" << initialTextBits << " to " << records.text.bits()
+         << " bits per symbol, " << records.next.bits() << " per link)" << endl;
+
+    return encode(output, dictionary, inputTransformations, skipPrepair, verbose);
+}
 
-    cout << "Compressed representation has " << output.size() << " symbols, dictionary has " << dictionary.size() << " entries (" << dictionary.numSymbols() << " symbols)" << endl;
-
-    if (verbose) {
-        for (auto elem : output) {
-            std::cout << elem << " ";
-        }
-        std::cout << std::endl << dictionary;
+/// RePair `data`, bit-packing the text if `compact` is set (which takes less memory, but more time), and
+/// compressing `numBlocks` blocks of it independently in parallel if that is larger than one (see BlockRePair).
+/// Unless `skipPrepair` is set, `data` is consolidated (see Prepair) the first time, storing the mapping in
+/// `inputTransformations`; later calls on the same data reuse that mapping.
+template <typename InType, typename DataType>
+long long compress(vector<InType> &data, const std::string &description, const bool compact, const int numBlocks,
+                   std::unordered_map<InType, InType> &inputTransformations, const bool skipPrepair, const bool verbose) {
+    if (compact) {
+        return compress<InType, DataType, true>(data, description, numBlocks, inputTransformations, skipPrepair, verbose);
     }
+    return compress<InType, DataType, false>(data, description, numBlocks, inputTransformations, skipPrepair, verbose);
+}
 
-    RePair::Coder<DataType> coder(output, dictionary);
-    if (!skipPrepair) {
-        coder.codeInputMapping(inputTransformations);
+/// Print the size of the blocked output, and how much larger it is than global RePair's (if that was run)
+void printBlockLoss(const int numBlocks, const long long globalSize, const long long blockedSize) {
+    cout << "With " << numBlocks << " blocks, the output needs " << blockedSize << " bits";
+    if (globalSize > 0) {
+        cout << ", " << std::fixed << std::setprecision(2) << 100.0 * (blockedSize - globalSize) / globalSize
+             << "% more than with global RePair (" << globalSize << " bits)";
+        cout.unsetf(std::ios_base::floatfield);
     }
-    coder.compute();
-    cout << coder.huff << " + " << coder.huff.getBitsForTableLabels() << " bits = " << (coder.getBitsNeeded() + 7) / 8 << " Bytes" << endl;
-    return coder.getBitsNeeded();
+    cout << endl;
 }
 
 int main(int argc, char **argv) {
@@ -73,6 +133,68 @@ int main(int argc, char **argv) {
         filename = argParser.getDataArg(0);
     }
     const bool verbose = argParser.isSet("v");
+    // bit-pack the text RePair works on, for inputs that don't fit into memory otherwise
+    const bool compact = argParser.isSet("c");
+    // RePair the input in this many blocks in parallel instead (see BlockRePair)
+    const int numBlocks = argParser.get<int>("b", 1);
+    // with blocks, also RePair the input globally and compare the results
+    const bool compareGlobal = numBlocks <= 1 || argParser.isSet("g");
+
+    // Benchmark: RePair a synthetic sequence instead of a file, which consists of k different words of
+    // two symbols each, separated by the symbol 0, in random order. Word i occurs h + i times, where h
+    // is chosen such that the sequence has about n symbols. With the default k, all pairs occur more
+    // than sqrt(n) times (and many of them differently often), which is the worst case for the
+    // priority queue. With -r m, each word is a run of m copies of one symbol instead, which RePair
+    // replaces in rounds of overlapping pairs, like the structure of a tree with many leaf children.
+    const long long syntheticLength = argParser.get<long long>("s", 0);
+    if (syntheticLength > 0) {
+        const int runLength = argParser.get<int>("r", 0);
+        const int wordLength = runLength > 0 ? runLength : 2;
+        const int numWords = argParser.get<int>("k", std::max(1, (int)sqrt(syntheticLength) / 6));
+        const long long baseCount = std::max(1LL, syntheticLength / ((wordLength + 1LL) * numWords) - numWords / 2);
+        std::vector<int> words;
+        for (int word = 0; word < numWords; ++word) {
+            words.insert(words.end(), baseCount + word, word);
+        }
+        std::mt19937 random(argParser.get<uint>("seed", 12345678));
+        std::shuffle(words.begin(), words.end(), random);
+        std::vector<int> sequence;
+        sequence.reserve((wordLength + 1) * words.size());
+        for (const int word : words) {
+            sequence.push_back(0);
+            if (runLength > 0) {
+                sequence.insert(sequence.end(), runLength, word + 1);
+            } else {
+                sequence.push_back(2 * word + 1);
+                sequence.push_back(2 * word + 2);
+            }
+        }
+        std::unordered_map<int, int> noTransformations;
+        long long size(0), blockedSize(0);
+        if (compareGlobal) {
+            size = compress<int, int>(sequence, "synthetic sequence", compact, 1, noTransformations, true, verbose);
+        }
+        if (numBlocks > 1) {
+            blockedSize = compress<int, int>(sequence, "synthetic sequence", compact, numBlocks, noTransformations, true, verbose);
+            printBlockLoss(numBlocks, size, blockedSize);
+        }
+        cout << "RESULT"
+             << " synthetic=" << sequence.size()
+             << " words=" << numWords;
+        if (runLength > 0) {
+            cout << " runlength=" << runLength;
+        }
+        if (compareGlobal) {
+            cout << " compressed=" << size;
+        }
+        if (numBlocks > 1) {
+            cout << " blocks=" << numBlocks
+                 << " blockcompressed=" << blockedSize;
+        }
+        cout << " peakRSS=" << getPeakMemoryUsage()
+             << endl;
+        return 0;
+    }
 
     OrderedTree<TreeNode, TreeEdge> tree;
     Labels<string> labels;
@@ -86,16 +208,34 @@ int main(int argc, char **argv) {
 
     cout << "bpstring with " << bpstring.size() << " bits, " << labelnames.size() << " bytes of labels (transformation took " << timer.getAndReset() << "ms)" << endl;
 
+    std::unordered_map<bool, bool> structureTransformations;
+    std::unordered_map<unsigned char, unsigned char> labelTransformations;
     long long totalSize(0);
-    totalSize += compress<bool, int>(bpstring, "tree structure", false, verbose);
-    totalSize += compress<unsigned char, int>(labelnames, "labels", verbose);
-    cout << "Output file needs " << totalSize << " bits (" << (totalSize + 7)/8 << " Bytes)" << endl;
+    if (compareGlobal) {
+        totalSize += compress<bool, int>(bpstring, "tree structure", compact, 1, structureTransformations, false, verbose);
+        totalSize += compress<unsigned char, int>(labelnames, "labels", compact, 1, labelTransformations, false, verbose);
+        cout << "Output file needs " << totalSize << " bits (" << (totalSize + 7)/8 << " Bytes)" << endl;
+    }
+
+    long long blockedSize(0);
+    if (numBlocks > 1) {
+        blockedSize += compress<bool, int>(bpstring, "tree structure", compact, numBlocks, structureTransformations, false, verbose);
+        blockedSize += compress<unsigned char, int>(labelnames, "labels", compact, numBlocks, labelTransformations, false, verbose);
+        printBlockLoss(numBlocks, totalSize, blockedSize);
+    }
 
     cout << "RESULT"
-         << " file=" << filename
-         << " compressed=" << totalSize
-         << " bpstringbits=" << bpstring.size()
-         << " labelstringits=" << labelnames.size() * 8
+         << " file=" << filename;
+    if (compareGlobal) {
+        cout << " compressed=" << totalSize;
+    }
+    cout << " bpstringbits=" << bpstring.size()
+         << " labelstringits=" << labelnames.size() * 8;
+    if (numBlocks > 1) {
+        cout << " blocks=" << numBlocks
+             << " blockcompressed=" << blockedSize;
+    }
+    cout << " peakRSS=" << getPeakMemoryUsage()
          << endl;
     return 0;
 }
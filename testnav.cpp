@@ -7,10 +7,15 @@
 
 #include <algorithm>
 #include <iostream>
+#include <random>
 #include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
 
 // Data structures
 #include "Edges.h"
+#include "FrozenTopDag.h"
 #include "Nodes.h"
 #include "OrderedTree.h"
 #include "TopDag.h"
@@ -23,6 +28,7 @@
 #include "TopDagUnpacker.h"
 #include "Navigation.h"
 #include "NavTest.h"
+#include "PreorderQueries.h"
 
 // Utils
 #include "ArgParser.h"
@@ -34,6 +40,124 @@
 using std::cout;
 using std::endl;
 using std::string;
+using std::vector;
+
+/// Traverse a frozen Top DAG with increasing numbers of threads, each using its own cursor,
+/// and report the navigation throughput
+void threadedBenchmark(const FrozenTopDag<string> &dag, const int maxThreads, const int rounds) {
+    Timer timer;
+    double singleThroughput(0);
+    // 1, 2, 4, ... threads, and finally maxThreads
+    for (int numThreads = 1; ; numThreads = std::min(2 * numThreads, maxThreads)) {
+        vector<unsigned long long> visited(numThreads, 0);
+        const auto worker = [&](const int id) {
+            for (int round = 0; round < rounds; ++round) {
+                PreorderTraversal<string, FrozenTopDag<string>> trav(dag);
+                visited[id] += trav.run().first;
+            }
+        };
+
+        vector<std::thread> workers;
+        timer.reset();
+        for (int id = 0; id < numThreads; ++id) {
+            workers.push_back(std::thread(worker, id));
+        }
+        for (std::thread &thread : workers) {
+            thread.join();
+        }
+        const double duration = timer.get();
+
+        unsigned long long totalVisited(0);
+        for (unsigned long long count : visited) {
+            totalVisited += count;
+        }
+        // nodes per microsecond = million nodes per second
+        const double throughput = totalVisited / (duration * 1000);
+        if (numThreads == 1) {
+            singleThroughput = throughput;
+        }
+        cout << numThreads << " threads: " << rounds << " traversals each took " << duration << "ms, "
+             << throughput << "M nodes/s (speedup " << throughput / singleThroughput << ")" << endl;
+        cout << "RESULT threads=" << numThreads << " rounds=" << rounds << " nodes=" << totalVisited
+             << " time=" << duration << " throughput=" << throughput << endl;
+        if (numThreads == maxThreads) break;
+    }
+}
+
+/// Run random parent, depth and LCA queries on preorder numbers and check them against the uncompressed tree
+template <typename TreeType>
+bool checkPreorderQueries(const TreeType &tree, const Labels<string> &labels, const TopDag<string> &dag,
+                          const int numQueries) {
+    Timer timer;
+    PreorderQueries<string> queries(dag);
+    cout << "Annotating the Top DAG for preorder queries took " << timer.getAndReset() << "ms" << endl;
+
+    // parent, depth and node ID of the tree nodes in preorder
+    const long long numNodes(tree._numNodes);
+    vector<long long> parents(numNodes), depths(numNodes);
+    vector<int> nodeIds(numNodes);
+    vector<std::tuple<int, long long, long long>> stack(1, std::make_tuple(0, -1, 1));
+    long long preorderNumber(0);
+    while (!stack.empty()) {
+        int nodeId;
+        long long parent, depth;
+        std::tie(nodeId, parent, depth) = stack.back();
+        stack.pop_back();
+        parents[preorderNumber] = parent;
+        depths[preorderNumber] = depth;
+        nodeIds[preorderNumber] = nodeId;
+        const size_t oldSize = stack.size();
+        FORALL_OUTGOING_EDGES(tree, nodeId, edge) {
+            if (edge->valid) {
+                stack.push_back(std::make_tuple(edge->headNode, preorderNumber, depth + 1));
+            }
+        }
+        std::reverse(stack.begin() + oldSize, stack.end());
+        ++preorderNumber;
+    }
+
+    std::uniform_int_distribution<long long> randomNode(0, numNodes - 1);
+    vector<long long> nodes(2 * numQueries);
+    for (long long &node : nodes) {
+        node = randomNode(getRandomGenerator());
+    }
+
+    bool correct = (queries.numNodes() == numNodes);
+    unsigned long long checksum(0);
+    timer.reset();
+    for (long long node : nodes) {
+        checksum += queries.parent(node) + queries.depth(node);
+    }
+    const double parentDepthDuration = timer.getAndReset();
+    for (int i = 0; i < numQueries; ++i) {
+        checksum += queries.lca(nodes[2 * i], nodes[2 * i + 1]);
+    }
+    const double lcaDuration = timer.getAndReset();
+    cout << 2 * numQueries << " parent+depth queries took " << parentDepthDuration << "ms, " << numQueries
+         << " LCA queries took " << lcaDuration << "ms (checksum " << checksum << ")" << endl;
+
+    for (int i = 0; i < numQueries && correct; ++i) {
+        long long a(nodes[2 * i]), b(nodes[2 * i + 1]);
+        correct = (queries.parent(a) == parents[a]) && (queries.depth(a) == depths[a]) &&
+                  (*queries.getLabel(a) == labels[nodeIds[a]]);
+        // naive LCA by walking up
+        const long long queryLca = queries.lca(a, b);
+        while (depths[a] > depths[b]) a = parents[a];
+        while (depths[b] > depths[a]) b = parents[b];
+        while (a != b) {
+            a = parents[a];
+            b = parents[b];
+        }
+        correct = correct && (queryLca == a);
+        if (!correct) {
+            cout << "Query results for nodes " << nodes[2 * i] << " and " << nodes[2 * i + 1] << " differ" << endl;
+        }
+    }
+    cout << "Preorder queries " << (correct ? "match" : "DO NOT MATCH") << " the uncompressed tree" << endl;
+    cout << "RESULT queries=" << numQueries << " parentDepthTime=" << parentDepthDuration << " lcaTime=" << lcaDuration
+         << " correct=" << correct << endl;
+    return correct;
+}
 
 int main(int argc, char **argv) {
     OrderedTree<TreeNode, TreeEdge> t;
@@ -48,12 +172,19 @@ int main(int argc, char **argv) {
         filename = (arg == "") ? filename : arg;
     }
     const bool print = argParser.isSet("p");
+    // multi-threaded benchmark with up to this many threads (0 = disabled)
+    const int maxThreads = argParser.isSet("t") ? argParser.get<int>("t", std::thread::hardware_concurrency()) : 0;
+    const int rounds = argParser.get<int>("n", 3);
+    // number of random parent/depth/LCA queries to check (0 = disabled)
+    const int numQueries = argParser.isSet("q") ? argParser.get<int>("q", 100000) : 0;
 
     Labels<string> labels;
     XmlParser<OrderedTree<TreeNode, TreeEdge>>::parse(filename, t, labels);
     cout << t.summary() << "; Height: " << t.height() << " Avg depth: " << t.avgDepth() << endl;
 
     const int treeEdges = t._numEdges;
+    // only keep a copy of the tree if we need it for checking queries
+    OrderedTree<TreeNode, TreeEdge> treeCopy(numQueries > 0 ? t : OrderedTree<TreeNode, TreeEdge>());
     TopDag<string> dag(t._numNodes, labels);
 
     Timer timer;
@@ -104,5 +235,15 @@ int main(int argc, char **argv) {
              << nodesVisited << " nodes; max tree stack size = "
              << maxTreeStackSize << " Bytes" << endl;
 
+    if (numQueries > 0 && !checkPreorderQueries(treeCopy, labels, dag, numQueries)) {
+        return 1;
+    }
+
+    if (maxThreads > 0) {
+        // the frozen copy can be shared, every thread navigates it with its own cursor
+        FrozenTopDag<string> frozenDag(dag);
+        threadedBenchmark(frozenDag, maxThreads, rounds);
+    }
+
     return 0;
 }